@@ -0,0 +1,159 @@
+#!/bin/bash
+# bench.sh
+#  Benchmarks for jkparse, run by make bench.  A deterministic corpus is
+# generated, and the following are measured for each of its documents:
+#  parse  - the time for jkparse itself to parse the document and generate
+#           its output, with each of several sets of options
+#  source - the end-to-end time for each shell to source the output with
+#           . <(jkparse ...), including for bash in the form selected by
+#           --shell=bash
+#  lib    - the end-to-end time for each shell to run the libjkparse.sh
+#           functions, including sourcing jkparse's output where they need it
+#  Each result is output as a line of JSON, so that results can be kept and
+# compared across versions, e.g.:
+# {"version":"12","build":"","benchmark":"parse","corpus":"wide","shell":"",
+# "command":"jkparse -q","bytes":1048576,"status":0,"seconds":0.012345,
+# "bytesPerSecond":84939101}
+#  The reported time is the fastest of the runs.  A shell that is not found is
+# reported once with a status of 127 and no time.
+
+#  Usage: bench.sh [JKPARSE [CORPUS_DIR]]
+#  JKPARSE defaults to bin/jkparse, and CORPUS_DIR to bench-corpus.  The
+# following environment variables are also read:
+#  BENCH_RUNS   - the number of runs of each measurement (default 3)
+#  BENCH_SCALE  - a multiplier for the size of each document (default 1)
+#  BENCH_SHELLS - the shells to source the output with (default: bash ksh zsh)
+
+export LC_ALL=C
+JKPARSE=$(cd "$(dirname "${1:-bin/jkparse}")" && pwd)/$(basename "${1:-bin/jkparse}")
+CORPUS_DIR=${2:-bench-corpus}
+LIBJKPARSE=$(cd "$(dirname "$0")" && pwd)/libjkparse.sh
+BENCH_RUNS=${BENCH_RUNS:-3}
+BENCH_SCALE=${BENCH_SCALE:-1}
+BENCH_SHELLS=${BENCH_SHELLS:-bash ksh zsh}
+. "$(dirname "$0")/corpus.sh"
+
+if ! [ -x "$JKPARSE" ];then
+	echo "jkparse not found at $JKPARSE" >&2
+	exit 1
+fi
+if [ -z "$EPOCHREALTIME" ];then
+	echo 'bash v5+ is required for $EPOCHREALTIME' >&2
+	exit 1
+fi
+VERSION=$("$JKPARSE" --version | sed -n '1s/.* //p')
+#  The compile time options, space separated
+BUILD=$("$JKPARSE" --version | sed -n '/^Compiled with:/,${/^ /{s/^ //;s/"/\\"/g;p;};}' |
+	tr '\n' ' ' | sed 's/ $//')
+
+
+#  Set BENCH_MICROSECONDS to the fastest of $BENCH_RUNS runs of the command in $@,
+# with stdin from $BENCH_INPUT and stdout discarded, and BENCH_STATUS to its
+# exit status
+function timeRuns
+{
+	typeset run start end elapsed fastest=
+	for ((run = 0; run < BENCH_RUNS; run++));do
+		start=${EPOCHREALTIME/./}
+		"$@" < "$BENCH_INPUT" > /dev/null 2>&1
+		BENCH_STATUS=$?
+		end=${EPOCHREALTIME/./}
+		elapsed=$((end - start))
+		if [ -z "$fastest" ] || [ $elapsed -lt $fastest ];then
+			fastest=$elapsed
+		fi
+	done
+	BENCH_MICROSECONDS=$fastest
+}
+
+
+#  Output a result
+#  $1 = benchmark
+#  $2 = corpus
+#  $3 = shell
+#  $4 = command, without any double quotes or backslashes
+#  $5 (optional) = status, with no time reported if given
+function report
+{
+	typeset bytes
+	bytes=$(wc -c < "$BENCH_INPUT")
+	if [ -n "$5" ];then
+		printf '{"version":"%s","build":"%s","benchmark":"%s","corpus":"%s","shell":"%s",'`
+			`'"command":"%s","bytes":%d,"status":%d,"seconds":null,"bytesPerSecond":null}\n' \
+			"$VERSION" "$BUILD" "$1" "$2" "$3" "$4" $bytes "$5"
+		return
+	fi
+	printf '{"version":"%s","build":"%s","benchmark":"%s","corpus":"%s","shell":"%s",'`
+		`'"command":"%s","bytes":%d,"status":%d,"seconds":%d.%06d,"bytesPerSecond":%d}\n' \
+		"$VERSION" "$BUILD" "$1" "$2" "$3" "$4" $bytes $BENCH_STATUS \
+		$((BENCH_MICROSECONDS / 1000000)) $((BENCH_MICROSECONDS % 1000000)) \
+		$((bytes * 1000000 / (BENCH_MICROSECONDS ? BENCH_MICROSECONDS : 1)))
+}
+
+
+makeCorpus "$CORPUS_DIR" || exit
+
+#  jkparse's own throughput
+for corpus in $CORPORA;do
+	BENCH_INPUT=$CORPUS_DIR/$corpus.json
+	case $corpus in
+	wide)
+		path='-p key100'
+		;;
+	long|deep|escapes)
+		path='-p 100'
+		;;
+	*)
+		path=
+		;;
+	esac
+	for options in '' '-q' '-a T' '-q -a T' '-f' '-j' '-S' '-S -a T' '--format=nul' \
+		${path:+"$path"};do
+		timeRuns "$JKPARSE" $options
+		report parse $corpus '' "jkparse${options:+ $options}"
+	done
+done
+
+#  The end-to-end time for each shell to source the output, and to run the
+# libjkparse.sh functions
+for shell in $BENCH_SHELLS;do
+	if ! command -v $shell > /dev/null;then
+		BENCH_INPUT=/dev/null
+		report source '' $shell '' 127
+		continue
+	fi
+	#  The name of the shell without its path or version, for --shell
+	target=${shell##*/}
+	target=${target%%[0-9]*}
+	for corpus in $CORPORA;do
+		BENCH_INPUT=$CORPUS_DIR/$corpus.json
+		timeRuns $shell -c '. <("$1" -a T)' $shell "$JKPARSE"
+		report source $corpus $shell '. <(jkparse -a T)'
+		if [ bash = "$target" ];then
+			timeRuns $shell -c '. <("$1" -a T --shell=bash)' $shell "$JKPARSE"
+			report source $corpus $shell '. <(jkparse -a T --shell=bash)'
+		fi
+		timeRuns $shell -c '. <("$1" -q)' $shell "$JKPARSE"
+		report source $corpus $shell '. <(jkparse -q)'
+		timeRuns $shell -c 'PATH=${1%/*}:$PATH; . "$2"; . <(jkparse -a T)
+			jkparseToJson "$JSON_TYPE" JSON_OBJ T' $shell "$JKPARSE" "$LIBJKPARSE"
+		report lib $corpus $shell jkparseToJson
+		timeRuns $shell -c 'PATH=${1%/*}:$PATH; . "$2"; . <(jkparse -q)
+			jkparseQToJson "$JSON_TYPE" JSON_OBJ' $shell "$JKPARSE" "$LIBJKPARSE"
+		report lib $corpus $shell jkparseQToJson
+	done
+	BENCH_INPUT=$CORPUS_DIR/wide.json
+	timeRuns $shell -c 'PATH=${1%/*}:$PATH; . "$2"; jkparseGet key100' \
+		$shell "$JKPARSE" "$LIBJKPARSE"
+	report lib wide $shell 'jkparseGet key100'
+	timeRuns $shell -c 'PATH=${1%/*}:$PATH; . "$2"; jkparseSet key100 1' \
+		$shell "$JKPARSE" "$LIBJKPARSE"
+	report lib wide $shell 'jkparseSet key100 1'
+	BENCH_INPUT=$CORPUS_DIR/long.json
+	timeRuns $shell -c 'PATH=${1%/*}:$PATH; . "$2"; jkparseGet 100' \
+		$shell "$JKPARSE" "$LIBJKPARSE"
+	report lib long $shell 'jkparseGet 100'
+	timeRuns $shell -c 'PATH=${1%/*}:$PATH; . "$2"; jkparseSet 100 1' \
+		$shell "$JKPARSE" "$LIBJKPARSE"
+	report lib long $shell 'jkparseSet 100 1'
+done
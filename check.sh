@@ -0,0 +1,150 @@
+#!/bin/bash
+# check.sh
+#  Checks for jkparse, run by make check.  Over the corpus of bench.sh and
+# the edge cases below, with each of several sets of options, the following
+# are compared:
+#  backend - the output and exit code of the tape parser and of json-c
+#  stream  - the output and exit code with -S and without it, for each
+#            backend.  Where the output differs, as it does for duplicate
+#            keys and for parse errors after output has begun, the variables
+#            declared by sourcing each output in bash are compared instead.
+#  Each difference is reported, followed by a count of the comparisons made
+# and of those that differed, and the exit status is 1 if any did.
+
+#  Usage: check.sh [JKPARSE_JSON_C [JKPARSE_TAPE [CORPUS_DIR]]]
+#  JKPARSE_JSON_C defaults to bin/jkparse-json-c, JKPARSE_TAPE to
+# bin/jkparse-tape, and CORPUS_DIR to bench-corpus.
+
+export LC_ALL=C
+JKPARSE_JSON_C=${1:-bin/jkparse-json-c}
+JKPARSE_TAPE=${2:-bin/jkparse-tape}
+CORPUS_DIR=${3:-bench-corpus}
+. "$(dirname "$0")/corpus.sh"
+
+for jkparse in "$JKPARSE_JSON_C" "$JKPARSE_TAPE";do
+	if ! [ -x "$jkparse" ];then
+		echo "jkparse not found at $jkparse" >&2
+		exit 1
+	fi
+done
+CHECK_DIR=$(mktemp -d) || exit
+trap 'rm -rf "$CHECK_DIR"' EXIT
+makeCorpus "$CORPUS_DIR" || exit
+
+
+#  The edge cases, each a name followed by its input, which is output with
+# printf %b, so that the input itself holds no escapes that are not JSON's
+EDGE_CASES=(
+	negativeZero '-0'
+	negativeZeros '[-0, -0.0, -0e0, 0e-5]'
+	hugeExponent '1E400'
+	hugeExponents '{"a": 1E400, "b": -1E400, "c": 1e-400, "d": 1.7976931348623157e308}'
+	hugeInteger '18446744073709551616'
+	hugeIntegers '[18446744073709551615, 18446744073709551616, 9223372036854775807,
+		9223372036854775808, -9223372036854775808, -9223372036854775809,
+		123456789012345678901234567890]'
+	duplicateKeys '{"a": 1, "b": [1], "a": 2, "c": {"d": 1, "d": [2]}, "b": {}}'
+	surrogates '["\\ud83d\\ude00", "\\ud83d", "\\ude00x", "\\ud83dx", "\\udbff\\udfff"]'
+	surrogateKeys '{"\\ud83d\\ude00": 1, "\\ud83d": 2, "\\ude00": 3}'
+	comments '/* before */ {"a": 1, // line\n "b": /* inside */ [2]} // after'
+	trailingGarbage '{"a": 1} x'
+	trailingBracket '[1, 2]]'
+	trailingValue '1 2'
+	nulInStrings '["a\\u0000b", "\\u0000", {"k": "v\\u0000"}]'
+	nulInKey '{"k\\u0000": "v", "\\u0000": 1}'
+	emptyKeyAndContainers '{"": [], "e": {}, "s": "", "n": null, "a": [[], {}]}'
+	string '"a b\\n"'
+	boolean 'true'
+	null 'null'
+	empty ''
+	whitespace ' \n\t '
+	truncated '[1, {"a": 2'
+	invalidLiteral '{"a": tru}'
+	invalidAfterMembers '[1, 2, x]'
+)
+
+
+#  The sets of options that each input is checked with
+OPTION_SETS=('' '-q' '-a T' '-q -a T' '-f' '-f -a T' '-j' '-l' '-u -a T' '--tree -a T'
+	'--format=nul' '--format=binary' '-p 0' '-p a' '--select=a' '--range=1:3')
+
+
+#  Run a jkparse in $1 with the options in $2, with stdin from $CHECK_INPUT, and
+# output to $CHECK_DIR/$3, with its exit status in $CHECK_DIR/$3.status
+function runJkparse
+{
+	"$1" $2 < "$CHECK_INPUT" > "$CHECK_DIR/$3" 2>/dev/null
+	echo $? > "$CHECK_DIR/$3.status"
+}
+
+
+#  Output the variables declared by sourcing the output in $CHECK_DIR/$1 within
+# a function, so that -l may be given.  A variable that is unset after being
+# declared there remains as a local variable without a value, and is omitted.
+function sourcedVariables
+{
+	bash -c 'function declareOutput
+		{
+			. "$1" 2>&1
+			typeset -p JSON_TYPE JSON_OBJ T ${!JSON_OBJ_*} ${!T_*} 2>/dev/null
+		}
+		declareOutput "$1"' _ "$CHECK_DIR/$1" | sed '/^declare -[^ ]* [^=]*$/d'
+}
+
+
+CHECKS=0
+FAILURES=0
+#  Compare the outputs in $CHECK_DIR/$1 and $CHECK_DIR/$2, and report a failure
+# described by $3 if they differ.  If $4 is given, outputs that differ are
+# compared by the variables that they declare.
+function compareOutputs
+{
+	((CHECKS++))
+	if cmp -s "$CHECK_DIR/$1.status" "$CHECK_DIR/$2.status";then
+		if cmp -s "$CHECK_DIR/$1" "$CHECK_DIR/$2";then
+			return
+		fi
+		if [ -n "$4" ] && [ "$(sourcedVariables "$1")" = "$(sourcedVariables "$2")" ];then
+			return
+		fi
+	fi
+	((FAILURES++))
+	echo "FAIL: $3"
+	echo "  exit status $(<"$CHECK_DIR/$1.status") and $(<"$CHECK_DIR/$2.status")"
+	cmp "$CHECK_DIR/$1" "$CHECK_DIR/$2" | sed 's/^/  /'
+}
+
+
+#  Check the input in $CHECK_INPUT, named by $1, with every set of options
+function checkInput
+{
+	typeset options
+	for options in "${OPTION_SETS[@]}";do
+		runJkparse "$JKPARSE_JSON_C" "$options" json-c
+		runJkparse "$JKPARSE_TAPE" "$options" tape
+		runJkparse "$JKPARSE_JSON_C" "-S $options" json-c-stream
+		runJkparse "$JKPARSE_TAPE" "-S $options" tape-stream
+		compareOutputs json-c tape "backend: $1: jkparse${options:+ $options}"
+		#  With -S and -f, the members flattened from an earlier occurrence of a duplicate key
+		# remain, as --help describes
+		if [ "$1" = duplicateKeys ] && [[ " $options " == *" -f "* ]];then
+			continue
+		fi
+		compareOutputs json-c json-c-stream "stream: $1: json-c: jkparse${options:+ $options}" \
+			sourced
+		compareOutputs tape tape-stream "stream: $1: tape: jkparse${options:+ $options}" sourced
+	done
+}
+
+
+for corpus in $CORPORA;do
+	CHECK_INPUT=$CORPUS_DIR/$corpus.json
+	checkInput $corpus
+done
+CHECK_INPUT=$CHECK_DIR/input.json
+for ((edgeCase = 0; edgeCase < ${#EDGE_CASES[@]}; edgeCase += 2));do
+	printf %b "${EDGE_CASES[edgeCase + 1]}" > "$CHECK_INPUT"
+	checkInput "${EDGE_CASES[edgeCase]}"
+done
+echo "$FAILURES of $CHECKS comparisons differed"
+[ $FAILURES -eq 0 ]
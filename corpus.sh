@@ -0,0 +1,102 @@
+#!/bin/bash
+# corpus.sh
+#  The deterministic corpus of documents that bench.sh measures and check.sh
+# checks, sourced by each of them.  Its documents are named by CORPORA, and are
+# sized by BENCH_SCALE, a multiplier that defaults to 1.
+
+CORPORA='wide long deep escapes keys unicode'
+
+
+#  Generate a document of the corpus, named by $1, on stdout.  Only integer
+# arithmetic and byte strings are used, so that every awk produces the same
+# document.
+function generateCorpus
+{
+	awk -v corpus="$1" -v scale="$BENCH_SCALE" '
+	#  A value of one of several types, varying with n
+	function scalar(n) {
+		if(n % 6 == 0) return n * 7 + 1
+		if(n % 6 == 1) return "\"value " n "\""
+		if(n % 6 == 2) return "-" n ".25e-3"
+		if(n % 6 == 3) return "true"
+		if(n % 6 == 4) return "null"
+		return "[" n ", \"two\", {\"three\": 3.0}]"
+	}
+	BEGIN {
+		if(corpus == "wide") {
+			#  A single object with many members
+			count = 50000 * scale
+			printf "{"
+			for(i = 0; i < count; i++)
+				printf "%s\"key%d\": %s", i ? ", " : "", i, scalar(i)
+			print "}"
+		} else if(corpus == "long") {
+			#  A single array with many members
+			count = 250000 * scale
+			printf "["
+			for(i = 0; i < count; i++)
+				printf "%s%s", i ? "," : "", scalar(i)
+			print "]"
+		} else if(corpus == "deep") {
+			#  Members nested to 30 levels, just within the depth limit of json-c
+			count = 5000 * scale
+			printf "["
+			for(i = 0; i < count; i++) {
+				printf "%s", i ? "," : ""
+				for(level = 0; level < 30; level++)
+					printf "%s", level % 2 ? "[" : "{\"level" level "\": "
+				printf "%d", i
+				for(level = 29; level >= 0; level--)
+					printf "%s", level % 2 ? "]" : "}"
+			}
+			print "]"
+		} else if(corpus == "escapes") {
+			#  Long strings of characters that need escaping in JSON or in the shell
+			count = 5000 * scale
+			segment = "a\\\"b\\\\c\\nd\\te\\u0001f\\/g'\''h$i`j!k l(m)n;o<p>q[r]s|t*u?v~w#x&y\\u007fz"
+			printf "["
+			for(i = 0; i < count; i++) {
+				printf "%s\"%d", i ? "," : "", i
+				for(repeat = 0; repeat < 8; repeat++)
+					printf "%s", segment
+				printf "\""
+			}
+			print "]"
+		} else if(corpus == "keys") {
+			#  Keys with every character that is escaped in an array subscript, and an
+			# empty key
+			count = 5000 * scale
+			split("\\t@ @!@\\\"@$@'\''@(@)@;@<@>@[@\\\\@]@`@|@a", chars, "@")
+			printf "{\"\": 0"
+			for(i = 0; i < count; i++)
+				printf ", \"k%d%sx%s\": %s", i, chars[i % 17 + 1], chars[(i * 7) % 17 + 1],
+					scalar(i)
+			print "}"
+		} else if(corpus == "unicode") {
+			#  Multibyte characters, raw and as \u escapes, in keys and values
+			count = 50000 * scale
+			split("\303\251t\303\251|\346\227\245\346\234\254\350\252\236|\360\237\230\200|" \
+				"\\u00e9\\u65e5|\\ud83d\\ude00|\316\261\316\262\316\263|\320\226\320\257", words, "|")
+			printf "{"
+			for(i = 0; i < count; i++)
+				printf "%s\"%s%d\": \"%s %s\"", i ? ", " : "", words[i % 7 + 1], i,
+					words[(i * 3) % 7 + 1], words[(i * 5) % 7 + 1]
+			print "}"
+		}
+	}'
+}
+
+
+#  Generate the corpus in the directory $1, unless it was last generated there
+# with the same scale
+function makeCorpus
+{
+	typeset corpus scale=${BENCH_SCALE:-1}
+	mkdir -p "$1" || return
+	if [ "$(cat "$1/scale" 2>/dev/null)" != "$scale" ];then
+		for corpus in $CORPORA;do
+			BENCH_SCALE=$scale generateCorpus $corpus > "$1/$corpus.json" || return
+		done
+		echo "$scale" > "$1/scale"
+	fi
+}
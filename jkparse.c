@@ -2,24 +2,32 @@
 //  JSON parser for shell scripts that utilizes the (associative) array capabilities of ksh and
 // similar shells.
 
-#define JKPRINT_VERSION_STRING "11"
+#define JKPRINT_VERSION_STRING "12"
 #define JKPRINT_VERSION_STRING_LONG "jkparse version " JKPRINT_VERSION_STRING \
 "\nCopyright (C) 2022-2024 Jason Hinsch\n" \
 "License: GPLv2 <https://www.gnu.org/licenses/old-licenses/gpl-2.0.html>\n" \
 "See https://github.com/jacre8/jkparse for the latest version and documentation\n"
 
 //  Compile with: gcc -O2 -o jkparse jkparse.c -ljson-c
-//  If it is desired to use a shell's builtin printf rather than coreutils' or another standalone
-// printf, declare USE_SHELL_PRINTF with the path to the shell as a constant string.
+//  Shell escaping of output values is performed natively, producing the same output as coreutils'
+// printf %q.  For comparison with an external implementation, the values may instead be escaped by
+// executing a standalone printf, by declaring PRINTF_EXECUTABLE with its path as a constant
+// string, or by executing a shell's builtin printf, by declaring USE_SHELL_PRINTF with the path to
+// the shell as a constant string.  Either of these spawns a process for every escaped value.
 // E.g: gcc -D 'USE_SHELL_PRINTF="/bin/ksh"' -O2 -o jkparse jkparse.c -ljson-c
+//  Declaring USE_TAPE_PARSER builds in a parser that parses a whole document onto a tape, with
+// json-c handling only the documents that it does not accept, and the other modes.
+//  Declaring USE_ZLIB or USE_ZSTD decompresses input compressed with gzip or zstd, respectively,
+// which then requires linking with -lz or -lzstd.
 
 #ifdef USE_SHELL_PRINTF
 	#ifndef SHELL_BASENAME
 		#define SHELL_BASENAME "ksh"
 	#endif
 	#define PRINTF_EXECUTABLE USE_SHELL_PRINTF
-#elif ! defined(PRINTF_EXECUTABLE)
-	#define PRINTF_EXECUTABLE "/usr/bin/printf"
+#endif
+#ifdef PRINTF_EXECUTABLE
+	#define USE_EXTERNAL_PRINTF
 #endif
 //#define TRIM_ARRAY_LEADING_SPACE  // for vanity's sake
 //  At least as early as zsh v5.7.1, the workarounds with the following option are uneceesary.
@@ -27,7 +35,18 @@
 //#define WORKAROUND_OLD_ZSH_SUBSCRIPT_BUGS
 
 #define _GNU_SOURCE // for fputs_unlocked
+#ifdef JKPARSE_BUILTIN
+	//  bash's headers for loadable builtins, which define some of the same exit codes as
+	// sysexits.h with other values
+	#include <config.h>
+	#include "loadables.h"
+	#undef EX_NOINPUT
+	#undef EX_USAGE
+#endif
+#include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 //  It is recommended that a symlink be created at json-c/json.h if it is located somewhere else.
 #ifdef __has_include
@@ -39,20 +58,382 @@
 #else
 	#include <json-c/json.h>
 #endif
+#include <limits.h>
+#include <locale.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdio_ext.h> // __fsetlocking()
 #include <stdlib.h>
 #include <string.h>
 #include <sysexits.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
+#include <wchar.h>
+#include <wctype.h>
+#ifdef USE_ZLIB
+	#include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+	#include <zstd.h>
+#endif
+#if defined(USE_ZLIB) || defined(USE_ZSTD)
+	#define USE_DECOMPRESSION
+#endif
 
-static void putShEscapedString(const char * str)
+//  json_tokener_get_parse_end() was introduced in json-c v0.15
+#if defined(JSON_C_VERSION_NUM) && JSON_C_VERSION_NUM < (15 << 8)
+	#define json_tokener_get_parse_end(tok) ((size_t)(tok)->char_offset)
+#endif
+
+//  The compile time options that affect the output, as listed by --version
+static const char buildOptions[] = ""
+#if defined(USE_EXTERNAL_PRINTF) && ! defined(USE_SHELL_PRINTF)
+	" PRINTF_EXECUTABLE=\"" PRINTF_EXECUTABLE "\"\n"
+#endif
+#ifdef TRIM_ARRAY_LEADING_SPACE
+	" TRIM_ARRAY_LEADING_SPACE\n"
+#endif
+#ifdef USE_SHELL_PRINTF
+	" USE_SHELL_PRINTF=\"" USE_SHELL_PRINTF "\"\n"
+#endif
+#ifdef USE_TAPE_PARSER
+	" USE_TAPE_PARSER\n"
+#endif
+#ifdef USE_ZLIB
+	" USE_ZLIB\n"
+#endif
+#ifdef USE_ZSTD
+	" USE_ZSTD\n"
+#endif
+#ifdef WORKAROUND_OLD_ZSH_SUBSCRIPT_BUGS
+	" WORKAROUND_OLD_ZSH_SUBSCRIPT_BUGS\n"
+#endif
+;
+
+//  All generated output is written here.  This is stdout, unless output is being buffered.
+static FILE * output;
+
+//  Statistics reported with --stats.  The counters are always kept, at the cost of an increment,
+// but the phases are only timed when statsFile is set.
+enum statsPhase
+{
+	STATS_OTHER,
+	STATS_READ,
+	STATS_PARSE,
+	STATS_ESCAPE_KEYS,
+	STATS_QUOTE_VALUES,
+	STATS_OUTPUT,
+	STATS_PHASE_COUNT
+};
+#ifndef JKPARSE_BUILTIN
+static const char * const statsPhaseNames[STATS_PHASE_COUNT] = {"other", "read", "parse",
+	"keyEscaping", "valueQuoting", "output"};
+#endif
+static struct
+{
+	//  The phase being timed, and when it started
+	enum statsPhase phase;
+	struct timespec phaseWallStart;
+	struct timespec phaseCpuStart;
+	//  The total time spent in each phase, in nanoseconds
+	long long wallTime[STATS_PHASE_COUNT];
+	long long cpuTime[STATS_PHASE_COUNT];
+	unsigned long long bytesRead;
+	unsigned long long bytesWritten;
+	unsigned long long membersOutput;
+	//  Key subscripts output, including those for JSON_OBJ_TYPES, that needed escaping
+	unsigned long long escapedKeys;
+	//  The strings escaped for the shell, and of those, the number that needed quoting when they
+	// are escaped natively, or the number of printf processes executed otherwise
+	unsigned long long shEscapedStrings;
+	unsigned long long shQuotedStrings;
+	unsigned long long printfProcesses;
+} stats;
+//  The file given with --stats, empty for stderr, or NULL if statistics are not reported
+static const char * statsPath = NULL;
+//  The stream statistics are reported to, which is only opened once options have been parsed
+static FILE * statsFile = NULL;
+
+static long long timespecDifference(const struct timespec * end, const struct timespec * start)
+{
+	return (end->tv_sec - start->tv_sec) * 1000000000LL + end->tv_nsec - start->tv_nsec;
+}
+
+
+//  Add the time since the last switch to the current phase's, switch to phase, and return the
+// phase switched from
+static enum statsPhase statsSwitchPhase(enum statsPhase phase)
+{
+	struct timespec wall, cpu;
+	enum statsPhase previousPhase = stats.phase;
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+	stats.wallTime[previousPhase] += timespecDifference(&wall, &stats.phaseWallStart);
+	stats.cpuTime[previousPhase] += timespecDifference(&cpu, &stats.phaseCpuStart);
+	stats.phaseWallStart = wall;
+	stats.phaseCpuStart = cpu;
+	stats.phase = phase;
+	return previousPhase;
+}
+
+//  Switch to timing newPhase if --stats is given, and return the phase to switch back to afterwards
+// with STATS_SET_PHASE()
+#define STATS_PHASE(newPhase) (statsFile ? statsSwitchPhase(newPhase) : stats.phase)
+#define STATS_SET_PHASE(previousPhase) (statsFile ? (void)statsSwitchPhase(previousPhase) : (void)0)
+
+
+#ifndef JKPARSE_BUILTIN
+//  Write size bytes of buffer to fd, and return the number written, which is less upon an error
+static size_t writeAll(int fd, const char * buffer, size_t size)
+{
+	size_t written = 0;
+	while(written < size)
+	{
+		ssize_t writeRc = write(fd, buffer + written, size - written);
+		if(-1 == writeRc)
+		{
+			if(EINTR == errno)
+				continue;
+			break;
+		}
+		written += writeRc;
+	}
+	return written;
+}
+
+
+//  Write to stdout for the output stream used with --stats, counting the bytes written
+static ssize_t statsWriteOutput(void * cookie, const char * buffer, size_t size)
+{
+	(void)cookie;
+	size_t written = writeAll(1, buffer, size);
+	stats.bytesWritten += written;
+	return written || ! size ? (ssize_t)written : -1;
+}
+
+
+//  Output the statistics as a line of JSON, at exit
+static void reportStats(void)
+{
+	struct rusage usage;
+	long long wallTime = 0;
+	long long cpuTime = 0;
+	STATS_SET_PHASE(STATS_OUTPUT);
+	fflush_unlocked(output);
+	STATS_SET_PHASE(STATS_OTHER);
+	for(int phase = 0; phase < STATS_PHASE_COUNT; phase++)
+	{
+		wallTime += stats.wallTime[phase];
+		cpuTime += stats.cpuTime[phase];
+	}
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(statsFile, "{\"wallSeconds\":%.6f,\"cpuSeconds\":%.6f,\"phases\":{",
+		wallTime / 1e9, cpuTime / 1e9);
+	for(int phase = 0; phase < STATS_PHASE_COUNT; phase++)
+		fprintf(statsFile, "%s\"%s\":{\"wallSeconds\":%.6f,\"cpuSeconds\":%.6f}", phase ? "," : "",
+			statsPhaseNames[phase], stats.wallTime[phase] / 1e9, stats.cpuTime[phase] / 1e9);
+	fprintf(statsFile, "},\"bytesRead\":%llu,\"bytesWritten\":%llu,\"membersOutput\":%llu,"
+		"\"escapedKeys\":%llu,\"shEscapedStrings\":%llu,\"shQuotedStrings\":%llu,"
+		"\"printfProcesses\":%llu,\"peakRssKiB\":%ld}\n", stats.bytesRead, stats.bytesWritten,
+		stats.membersOutput, stats.escapedKeys, stats.shEscapedStrings, stats.shQuotedStrings,
+		stats.printfProcesses, usage.ru_maxrss);
+	if(stderr != statsFile)
+		fclose(statsFile);
+}
+
+
+//  Begin collecting statistics for --stats, with the output counted through a stream that writes
+// to stdout.  Return 0, or the exit code upon failure.
+static int startStats(void)
+{
+	if(! *statsPath)
+		statsFile = stderr;
+	else if(! (statsFile = fopen(statsPath, "w")))
+	{
+		fprintf(stderr, "Unable to open %s: %s\n", statsPath, strerror(errno));
+		return EX_CANTCREAT;
+	}
+	if(! (output = fopencookie(NULL, "w", (cookie_io_functions_t){.write = statsWriteOutput})))
+		return EX_OSERR;
+	__fsetlocking(output, FSETLOCKING_BYCALLER);
+	clock_gettime(CLOCK_MONOTONIC, &stats.phaseWallStart);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stats.phaseCpuStart);
+	atexit(reportStats);
+	return EXIT_SUCCESS;
+}
+
+
+#ifndef USE_EXTERNAL_PRINTF
+//  Return the length, in bytes, of the character at str and set *printable according to whether
+// or not it is printable in the current locale.  Invalid and incomplete multibyte sequences are
+// reported as single, unprintable bytes.
+static size_t shCharLength(const char * str, int * printable)
+{
+	unsigned char c = *str;
+	if(0x80 > c || 1 == MB_CUR_MAX)
+	{
+		*printable = isprint(c);
+		return 1;
+	}
+	mbstate_t state;
+	memset(&state, 0, sizeof(state));
+	wchar_t wc;
+	size_t length = mbrtowc(&wc, str, MB_CUR_MAX, &state);
+	if((size_t)-2 <= length)
+	{
+		*printable = 0;
+		return 1;
+	}
+	*printable = iswprint(wc);
+	return length;
+}
+
+//  This produces the same output as coreutils' printf %q, which is gnulib's shell-escape quoting
+// style: the string is output as-is when it has no characters that are special to the shell.
+// Otherwise, it is surrounded by single quotes, with unprintable characters output as ANSI-C $''
+// escapes, unless the string contains single quotes and can be surrounded by double quotes
+// without any escaping.  bash, ksh93, and zsh all read the output back to the original string.
+static void writeShEscapedString(const char * str)
+{
+	//  A null object member has no string; output nothing for it, as printf does when the
+	// argument is missing
+	if(! str)
+		return;
+	int needsQuoting = ! *str;
+	int hasSingleQuote = 0;
+	int doubleQuotable = 1;
+	const char * pos = str;
+	while(*pos)
+	{
+		int printable;
+		size_t charLength = shCharLength(pos, &printable);
+		if(! printable)
+		{
+			needsQuoting = 1;
+			doubleQuotable = 0;
+		}
+		else if(1 == charLength)
+		{
+			switch(*pos)
+			{
+			case '\'':
+				hasSingleQuote = 1;
+				#if defined(__GNUC__) && __GNUC__ >= 7
+					__attribute__((fallthrough));
+				#endif
+			case ' ':
+				needsQuoting = 1;
+				break;
+			case '{': case '}':
+				//  These are only special when isolated
+				if(pos[1] || pos != str)
+				{
+					doubleQuotable = 0;
+					break;
+				}
+				#if defined(__GNUC__) && __GNUC__ >= 7
+					__attribute__((fallthrough));
+				#endif
+			case '#': case '~':
+				//  These are only special at the start of a word
+				if(pos == str)
+					needsQuoting = 1;
+				else
+					doubleQuotable = 0;
+				break;
+			case '!': case '"': case '$': case '&': case '(': case ')': case '*': case ';':
+			case '<': case '=': case '>': case '?': case '[': case '\\': case '^': case '`':
+			case '|':
+				needsQuoting = 1;
+				doubleQuotable = 0;
+				break;
+			}
+		}
+		pos += charLength;
+	}
+	if(! needsQuoting)
+	{
+		fwrite_unlocked(str, pos - str, 1, output);
+		return;
+	}
+	stats.shQuotedStrings++;
+	if(hasSingleQuote && doubleQuotable)
+	{
+		putc_unlocked('"', output);
+		fwrite_unlocked(str, pos - str, 1, output);
+		putc_unlocked('"', output);
+		return;
+	}
+	putc_unlocked('\'', output);
+	int inAnsiCQuotes = 0;
+	for(pos = str; *pos; )
+	{
+		int printable;
+		size_t charLength = shCharLength(pos, &printable);
+		if(printable)
+		{
+			if('\'' == *pos)
+				//  When in ANSI-C quotes, the leading quote here terminates those instead
+				fputs_unlocked("'\\''", output);
+			else
+			{
+				if(inAnsiCQuotes)
+					fputs_unlocked("''", output);
+				fwrite_unlocked(pos, charLength, 1, output);
+			}
+			inAnsiCQuotes = 0;
+			pos += charLength;
+		}
+		else
+		{
+			static const char controlChars[] = "\a\b\f\n\r\t\v";
+			static const char controlEscapes[] = "abfnrtv";
+			const char * controlChar;
+			if(! inAnsiCQuotes)
+			{
+				fputs_unlocked("'$'", output);
+				inAnsiCQuotes = 1;
+			}
+			putc_unlocked('\\', output);
+			if(1 == charLength && (controlChar = strchr(controlChars, *pos)))
+				putc_unlocked(controlEscapes[controlChar - controlChars], output);
+			else
+			{
+				unsigned char c = *(pos++);
+				while(1)
+				{
+					putc_unlocked('0' + (c >> 6), output);
+					putc_unlocked('0' + ((c >> 3) & 7), output);
+					putc_unlocked('0' + (c & 7), output);
+					if(! --charLength)
+						break;
+					c = *(pos++);
+					putc_unlocked('\\', output);
+				}
+				continue;
+			}
+			pos++;
+		}
+	}
+	putc_unlocked('\'', output);
+}
+#else
+static void writeShEscapedString(const char * str)
 {
-	fflush_unlocked(stdout);
+	//  Capture the output with a pipe, since output may not be stdout
+	int pipeFds[2];
+	if(pipe(pipeFds))
+		exit(EX_OSERR);
 	pid_t pid = vfork();
 	if(0 == pid) 
 	{
+		dup2(pipeFds[1], 1);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
 	#ifdef USE_SHELL_PRINTF
 			static const char * const shellBasename = SHELL_BASENAME;
 			execv(USE_SHELL_PRINTF, (char * const []){(char *)shellBasename, "-c", "printf %q \"$1\"",
@@ -63,8 +444,16 @@ static void putShEscapedString(const char * str)
 	#endif
 		_exit(EX_OSFILE);
 	}
+	close(pipeFds[1]);
 	if(-1 == pid)
 		exit(EX_OSERR);
+	stats.printfProcesses++;
+	char buffer[4096];
+	ssize_t readRc;
+	while(0 < (readRc = read(pipeFds[0], buffer, sizeof(buffer))) || (-1 == readRc && EINTR == errno))
+		if(0 < readRc)
+			fwrite_unlocked(buffer, readRc, 1, output);
+	close(pipeFds[0]);
 	int status;
 	waitpid(pid, &status, 0);
 	if(status)
@@ -73,432 +462,1329 @@ static void putShEscapedString(const char * str)
 		exit(WIFEXITED(status) ? WEXITSTATUS(status) : (WIFSIGNALED(status) ? 128 + status : status));
 	}
 }
+#endif
 
 
-static void putJsonEscapedString(void (* putf)(const char *), const char * str,
-	int withSurroundingQuotes)
+static void putShEscapedString(const char * str)
 {
-	//  For proper JSON formatting, use the json-c library to escape the string's characters.  To
-	// get the library to do this, add it to a json array object and remove the array formatting.
-	int paddingOffset = 1 + (! withSurroundingQuotes);
-	json_object *jarray = json_object_new_array();
-	json_object_array_add(jarray, json_object_new_string(str));
-	//  json_object_to_json_string_ext(jarray, JSON_C_TO_STRING_PLAIN) will return the string
-	// as '["str"]'.
-	//  json_object_to_json_string_length() is only present in json-c v0.13, or newer.  The
-	// JSON_C_TO_STRING_PRETTY_TAB macro was also introduced in v0.13.
-	#ifdef JSON_C_TO_STRING_PRETTY_TAB
-		size_t termCharIndex;
-		char * arrayedStr = (char *)json_object_to_json_string_length(jarray,
-			JSON_C_TO_STRING_PLAIN, &termCharIndex);
-		termCharIndex -= paddingOffset;
-	#else
-		char * arrayedStr = (char *)json_object_to_json_string_ext(jarray, JSON_C_TO_STRING_PLAIN);
-		size_t termCharIndex = strlen(arrayedStr) - paddingOffset;
-	#endif
-	// The leading '[' is easily accounted for, but we must come back and strip the trailing ']'.
-	// Albeit bad form, it does work to terminate it in place rather than copy the whole string.
-	arrayedStr[termCharIndex] = 0;
-	putf(arrayedStr + paddingOffset);
-	//  To avoid potential issues without making assumptions about json-c's implementation,
-	// put the trailing ']' back before freeing jarray
-	arrayedStr[termCharIndex] = ']';
-	json_object_put(jarray);
+	enum statsPhase previousPhase = STATS_PHASE(STATS_QUOTE_VALUES);
+	stats.shEscapedStrings++;
+	writeShEscapedString(str);
+	STATS_SET_PHASE(previousPhase);
 }
+#endif
 
 
-static void putShEscapedAndQuotedJsonString(const char * str)
+//  The character following the backslash in json-c's escape for each byte, 'u' for the \u00XX
+// escape of other control characters, or 0 if the byte is output as it is
+static const char jsonEscapeChars[256] = {
+	[0 ... '\b' - 1] = 'u', ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', ['\v'] = 'u', ['\f'] = 'f',
+	['\r'] = 'r', ['\r' + 1 ... 0x1F] = 'u', ['"'] = '"', ['/'] = '/', ['\\'] = '\\'
+};
+
+//  Each byte of a word set to c
+#define WORD_OF_BYTES(c) (~(uint64_t)0 / 0xFF * (c))
+//  Non-zero if any byte of word is less than c, which must be at most 0x80
+#define WORD_HAS_BYTE_LESS_THAN(word, c) \
+	(((word) - WORD_OF_BYTES(c)) & ~(word) & WORD_OF_BYTES(0x80))
+#define WORD_HAS_BYTE(word, c) WORD_HAS_BYTE_LESS_THAN((word) ^ WORD_OF_BYTES(c), 1)
+
+//  Return the length of the longest prefix of the length bytes at str that needs no escaping in
+// JSON.  Runs of such bytes are skipped a word at a time.
+static size_t jsonUnescapedLength(const char * str, size_t length)
 {
-	putJsonEscapedString(putShEscapedString, str, 1);
+	size_t pos = 0;
+	for(; pos + sizeof(uint64_t) <= length; pos += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, str + pos, sizeof(word));
+		if(WORD_HAS_BYTE_LESS_THAN(word, ' ') | WORD_HAS_BYTE(word, '"') |
+			WORD_HAS_BYTE(word, '/') | WORD_HAS_BYTE(word, '\\'))
+			break;
+	}
+	while(pos < length && ! jsonEscapeChars[(unsigned char)str[pos]])
+		pos++;
+	return pos;
 }
 
 
-//  For use with putJsonEscapedString()
-static void stdPutf(const char * str)
+//  Output the length bytes at str escaped for use in a JSON string, exactly as json-c escapes them
+static void putJsonEscapedChars(const char * str, size_t length)
 {
-	fputs_unlocked(str, stdout);
+	while(1)
+	{
+		size_t unescapedLength = jsonUnescapedLength(str, length);
+		fwrite_unlocked(str, 1, unescapedLength, output);
+		if(unescapedLength == length)
+			break;
+		unsigned char c = str[unescapedLength];
+		putc_unlocked('\\', output);
+		putc_unlocked(jsonEscapeChars[c], output);
+		if('u' == jsonEscapeChars[c])
+		{
+			fputs_unlocked("00", output);
+			putc_unlocked("0123456789abcdef"[c >> 4], output);
+			putc_unlocked("0123456789abcdef"[c & 0xF], output);
+		}
+		str += unescapedLength + 1;
+		length -= unescapedLength + 1;
+	}
 }
 
-static void valPrintWithQuotedStrings(json_object * val)
+
+static void putJsonEscapedString(const char * str, int withSurroundingQuotes)
 {
-	if(val)
-		(json_type_string == json_object_get_type(val) ? putShEscapedAndQuotedJsonString :
-			putShEscapedString)(json_object_get_string(val));
-	else
-		fputs_unlocked("null", stdout);
+	if(withSurroundingQuotes)
+		putc_unlocked('"', output);
+	putJsonEscapedChars(str, strlen(str));
+	if(withSurroundingQuotes)
+		putc_unlocked('"', output);
 }
 
 
-int main(int argc, char **argv)
+//  A memory stream that is rewound for each use, to hold text that is then output differently
+struct reusedStream
 {
-	char *arrayVarName = "";
-	char *objVarName = "JSON_OBJ";
-	char *typeVarName = "JSON_TYPE";
-	char *emptyKey = "$'\\1'";
-	const char * declareStr = "typeset";
-	int quoteStrings = 0;
-	int unsetVars = 0;
-	int verbose = 0;
-	__fsetlocking(stdout, FSETLOCKING_BYCALLER);
+	FILE * stream;
+	char * text;
+	size_t length;
+};
+
+//  Rewind reused, opening it first if necessary, and return its stream
+static FILE * rewindReusedStream(struct reusedStream * reused)
+{
+	if(! reused->stream)
 	{
-		int stringify = 0;
-		int currentoption;
-		static const struct option longopts[] = {
-			// {.name, .has_arg, .flag, .val}
-			{"help", no_argument, NULL, '!'},
-			{"array-var", required_argument, NULL, 'a'},
-			{"empty-key", required_argument, NULL, 'e'},
-			{"local-declarations", no_argument, NULL, 'l'},
-			{"obj-var", required_argument, NULL, 'o'},
-			{"quote-strings", no_argument, NULL, 'q'},
-			{"short-version", no_argument, NULL, 'v'},
-			{"stringify", no_argument, NULL, 's'},
-			{"type-var", required_argument, NULL, 't'},
-			{"unset-vars", no_argument, NULL, 'u'},
-			{"verbose", no_argument, NULL, 'V'},
-			{"version", no_argument, NULL, '@'},
-			{0, 0, 0, 0}
-		};
-		opterr = 0;
-		while( -1 != (currentoption = getopt_long(argc, argv, "a:e:lo:qst:uvV", longopts, &currentoption)) )
-		{
-			switch(currentoption)
-			{
-			case '!':
-				puts(
-					"Typical usage: . <(jkparse [OPTIONS...] [JSON])\n"
-					"  Parse JSON and return shell code for variable initialization based on the\n"
-					"JSON contents.  This will read the JSON to parse either from the first non-\n"
-					"option argument or, if one is not present, from stdin.  The returned shell code\n"
-					"can be processed by bash v4+, ksh93, or zsh v5.5+.  Two variable declarations\n"
-					"are output:\n"
-					"  JSON_TYPE - this is a single character describing the detected type of the\n"
-					"JSON argument.  This character is the first character for one of the following\n"
-					"types: null, boolean, int, double, string, array, or object.  The type will be\n"
-					"null if JSON cannot be represented by one of the other types.\n"
-					"  JSON_OBJ - this is the parsed result.  It is formatted based on JSON_TYPE as\n"
-					"one of the following:\n"
-					" null - empty string\n"
-					" boolean - string containing either 'true' or 'false'\n"
-					" int, double - decimal string value\n"
-					" string - string value without quotes or JSON escapes\n"
-					" array - array containing a string representation of each member\n"
-					" object - associative array containing a string representation of each member\n"
-					"  Output values whose type is neither string nor null can always be fed back\n"
-					"through this program, without modification, for further processing.  String and\n"
-					"null typed output values can also be fed back through, without modification, if\n"
-					"the --quote-strings option is specified when the output is generated.\n"
-					"  There is no special handling for duplicated keys in objects.  When there are\n"
-					"duplicate keys, multiple assignments will be output in the order that the keys\n"
-					"appear in the original JSON.\n"
-					"  This does not stream process the input when reading from stdin; if ever input\n"
-					"stream processing were implemented, this may output the variable declarations\n"
-					"twice.\n"
-					"\n"
-					"OPTIONS:\n"
-					" -a, --array-var=JSON_OBJ_TYPES\n"
-					"    When JSON_OBJ is either an array or object type, declare a third variable,\n"
-					"  named JSON_OBJ_TYPES, that contains an array or associative array containing\n"
-					"  characters corresponding to the types of the array or object's members,\n"
-					"  respectively.  The characters in this array are the same characters used in\n"
-					"  JSON_TYPE.  When JSON_OBJ_TYPES is an empty string, which is the default,\n"
-					"  this variable declaration is omitted from the output\n"
-					" -e, --empty-key=EMPTY_KEY\n"
-					"    Empty keys are valid in JSON but not in shell script arrays.  Specify a\n"
-					"  string to replace empty keys with.  The default is $'\\1'.  This value must\n"
-					"  be suitable for shell use.  No verification or substitution in the output is\n"
-					"  made for a non-empty value that is specified here.  If EMPTY_KEY is an empty\n"
-					"  string, object values with empty keys will be excluded from the output\n"
-					" -l, --local-declarations\n"
-					"    Declare variables using the local keyword rather than the default, typeset\n"
-					" -o, --obj-var=JSON_OBJ\n"
-					"    Specify a variable name for JSON_OBJ other than the default, JSON_OBJ.\n"
-					"  If blank, the object and array variables will be omitted from the output\n"
-					" -q, --quote-strings\n"
-					"    Include quotations around output string values, and escape as necessary to\n"
-					"  generate valid JSON, so that they can be fed back through this program with\n"
-					"  corresponding type detection.  For the sake of subsequent encoding, the type\n"
-					"  indicator for strings will be 'q' with this option instead of 's'.  With this\n"
-					"  option, null values will also be explictily output as null, rather than as\n"
-					"  empty strings\n"
-					" -s, --stringify\n"
-					"    Take the input and output it escaped as a JSON string, without surrounding\n"
-					"  quotes, whitespace, or shell escapes.  This is a formatting-only function\n"
-					"  that is intended for use in constructing JSON text.  The only other option\n"
-					"  that this may be logically combined with is -q, which only adds surrounding\n"
-					"  quotes in the output when combined\n"
-					" -t, --type-var=JSON_TYPE\n"
-					"    Specify a variable name for JSON_TYPE other than the default, JSON_TYPE.\n"
-					"  If blank, the type variable will be omitted from the output\n"
-					" -u, --unset-vars\n"
-					"    Output commands to unset JSON_OBJ and, if defined, JSON_OBJ_TYPES, before\n"
-					"  outputting their new declarations.  This permits re-using the same variable\n"
-					"  names, and using JSON_OBJ for both input and output, while transversing an\n"
-					"  object\n"
-					" -v, --short-version\n"
-					"    Output just the version number and exit\n"
-					" -V, --verbose\n"
-					"    If there is a parse error, output a descriptive message to stderr\n"
-					" --help\n"
-					"    This help screen\n"
-					" --version\n"
-					"    Output version, copyright, and build options, then exit\n"
-					"  Any non-empty variable name specified via an option will appear verbatim in\n"
-					"the output without additional verification.  Additional options for variable\n"
-					"declaration may be specified in the -a, -o, and -t option arguments.  E.g.,\n"
-					"-o '-g JSON_OBJ' will promote the scope of the object's declaration in BASH."
-				);
-				return EXIT_SUCCESS;
-			case 'a':
-				arrayVarName = optarg;
-				break;
-			case 'e':
-				emptyKey = optarg;
-				break;
-			case 'l':
-				declareStr = "local";
-				break;
-			case 'o':
-				objVarName = optarg;
-				break;
-			case 'q':
-				quoteStrings = 1;
-				break;
-			case 't':
-				typeVarName = optarg;
-				break;
-			case 's':
-				stringify = 1;
-				break;
-			case 'u':
-				unsetVars = 1;
-				break;
-			case 'v':
-				fputs_unlocked(JKPRINT_VERSION_STRING "\n", stdout);
-				return EXIT_SUCCESS;
-				break;
-			case 'V':
-				verbose = 1;
-				break;
-			case '@':
-				fputs_unlocked(JKPRINT_VERSION_STRING_LONG
-					"Compiled with:\n"
-					#ifndef USE_SHELL_PRINTF
-						" PRINTF_EXECUTABLE=\"" PRINTF_EXECUTABLE "\"\n"
-					#endif
-					#ifdef TRIM_ARRAY_LEADING_SPACE
-						" TRIM_ARRAY_LEADING_SPACE\n"
-					#endif
-					#ifdef USE_SHELL_PRINTF
-						" USE_SHELL_PRINTF=\"" USE_SHELL_PRINTF "\"\n"
-					#endif
-					#ifdef WORKAROUND_OLD_ZSH_SUBSCRIPT_BUGS
-						" WORKAROUND_OLD_ZSH_SUBSCRIPT_BUGS\n"
-					#endif
-					, stdout
-				);
-				return EXIT_SUCCESS;
-				break;
-			case '?':
-				fprintf(stderr, "Invalid option: -%c\n", optopt);
-				#if defined(__GNUC__) && __GNUC__ >= 7
-					__attribute__((fallthrough));
-				#endif
-			default:
-				return EX_USAGE;
-			}
-		}
-		if(stringify)
-		{
-			char * input;
-			if(optind < argc)
-				input = argv[optind];
-			else if(1 > scanf("%m[\x01-\xFF]", &input))
-			{
-				//  errno will be 0 if the input was an empty string
-				if(errno) {
-					if(verbose)
-						fprintf(stderr, "Error reading input: %s\n", strerror(errno));
-				}
-				else if(quoteStrings)
-					fputs_unlocked("\"\"", stdout);
-				return errno;
-			}
-			putJsonEscapedString(stdPutf, input, quoteStrings);
-			return 0;
-		}
+		if(! (reused->stream = open_memstream(&reused->text, &reused->length)))
+			exit(EX_OSERR);
+		__fsetlocking(reused->stream, FSETLOCKING_BYCALLER);
 	}
+	rewind(reused->stream);
+	return reused->stream;
+}
+
+
+//  The JSON strings returned by quotedJsonString()
+static struct reusedStream quotedJsonStream;
+
+//  Return the length characters of str escaped and quoted as a JSON string, which is valid until
+// the next call
+static const char * quotedJsonChars(const char * str, size_t length)
+{
+	FILE * valueOutput = output;
+	output = rewindReusedStream(&quotedJsonStream);
+	putc_unlocked('"', output);
+	putJsonEscapedChars(str, length);
+	putc_unlocked('"', output);
+	putc_unlocked(0, output);
+	fflush_unlocked(output);
+	output = valueOutput;
+	return quotedJsonStream.text;
+}
+
+
+//  Return str escaped and quoted as a JSON string, which is valid until the next call
+static const char * quotedJsonString(const char * str)
+{
+	return quotedJsonChars(str, strlen(str));
+}
+
+
+#ifndef JKPARSE_BUILTIN
+static void putShEscapedAndQuotedJsonString(const char * str)
+{
+	//  The JSON string is escaped into a reused memory stream, and then escaped for the shell
+	enum statsPhase previousPhase = STATS_PHASE(STATS_QUOTE_VALUES);
+	putShEscapedString(quotedJsonString(str));
+	STATS_SET_PHASE(previousPhase);
+}
+#endif
+
+
+//  Parsed values are output through the following functions, which hide the parser backend that
+// produced them.  json-c is always used, but with USE_TAPE_PARSER, a whole document is first
+// parsed by the built-in tape parser, which is much lighter on allocations.  Only documents that
+// it does not accept, whether they are invalid or use the extensions that json-c accepts, such as
+// comments, are then parsed by json-c, so that both backends produce the same output and exit
+// code.  The modes that parse incrementally, or that edit the parsed value, always use json-c.
+#ifdef USE_TAPE_PARSER
+//  A tape holds a document as an array of entries in document order, with each array or object
+// followed by its members.  An object's member is the entry for its key followed by its value.
+struct tapeEntry
+{
+	json_type type;
+	//  The number of entries taken by the value, including the members of an array or object
+	size_t size;
+	union
+	{
+		//  The number of members of an array or object, not counting repeated keys
+		size_t count;
+		//  The length of a string, which may include NUL characters
+		size_t length;
+		//  For a key, the offset to the value of its member, or 0 if the key repeats an earlier
+		// key.  As with json-c, the member of a repeated key keeps the position of the first
+		// member with that key, and takes the value of the last one.
+		size_t value;
+	};
+	//  The NUL terminated text of a key, string, number, or boolean
+	const char * text;
+};
+
+//  A value is either an entry of the tape, or a json-c object, with neither for a json-c null
+typedef struct
+{
+	const struct tapeEntry * entry;
 	json_object * obj;
-	enum json_tokener_error parseError = 0;
-	if(optind < argc)
+} jsonValue;
+#define JSON_C_VALUE(object) ((jsonValue){NULL, (object)})
+#define JSON_C_OBJECT(val) ((val).obj)
+#define TAPE_VALUE(tapeEntry) ((jsonValue){(tapeEntry), NULL})
+#else
+typedef json_object * jsonValue;
+#define JSON_C_VALUE(object) (object)
+#define JSON_C_OBJECT(val) (val)
+#endif
+
+
+static json_type valueType(jsonValue val)
+{
+#ifdef USE_TAPE_PARSER
+	if(val.entry)
+		return val.entry->type;
+#endif
+	return json_object_get_type(JSON_C_OBJECT(val));
+}
+
+
+//  An iterator over the members of an array or object
+struct memberIterator
+{
+#ifdef USE_TAPE_PARSER
+	const struct tapeEntry * entry;
+	const struct tapeEntry * end;
+#endif
+	json_type type;
+	json_object * array;
+	size_t index;
+	size_t length;
+	struct json_object_iterator objectIterator;
+	struct json_object_iterator objectEnd;
+};
+
+//  Start iterating over the members of container, which has none unless it is an array or object
+static void beginMembers(jsonValue container, struct memberIterator * members)
+{
+	members->type = valueType(container);
+	members->index = members->length = 0;
+#ifdef USE_TAPE_PARSER
+	members->entry = members->end = NULL;
+	if(container.entry)
 	{
-		//  The JSON object is an argument
-		obj = json_tokener_parse_verbose(argv[optind], &parseError);
+		members->entry = container.entry + 1;
+		members->end = container.entry + container.entry->size;
+		return;
 	}
-	else
+#endif
+	if(json_type_object == members->type)
 	{
-		//  Read the JSON object from stdin
-		struct json_tokener *tok = json_tokener_new();
-		if(! tok)
-			return EX_OSERR;
-		do
+		members->objectIterator = json_object_iter_begin(JSON_C_OBJECT(container));
+		members->objectEnd = json_object_iter_end(JSON_C_OBJECT(container));
+	}
+	else if(json_type_array == members->type)
+	{
+		members->array = JSON_C_OBJECT(container);
+		members->length = json_object_array_length(members->array);
+	}
+}
+
+
+//  Set *member to the next member, and *key to its key, or NULL for an array's member.  Return 0
+// without setting either after the last member.
+static int nextMember(struct memberIterator * members, const char ** key, jsonValue * member)
+{
+#ifdef USE_TAPE_PARSER
+	if(members->entry)
+	{
+		while(members->entry < members->end)
 		{
-			char inputBuffer[65536];
-			ssize_t readRc = read(0, inputBuffer, sizeof(inputBuffer));
-			if(0 >= readRc)
+			const struct tapeEntry * entry = members->entry;
+			if(json_type_array == members->type)
 			{
-				parseError = json_tokener_error_parse_eof;
-				break;
+				members->entry += entry->size;
+				*key = NULL;
+				*member = TAPE_VALUE(entry);
+				return 1;
+			}
+			members->entry += 1 + entry[1].size;
+			//  A member with a repeated key is skipped
+			if(entry->value)
+			{
+				*key = entry->text;
+				*member = TAPE_VALUE(entry + entry->value);
+				return 1;
 			}
-			obj = json_tokener_parse_ex(tok, inputBuffer, readRc);
 		}
-		while(json_tokener_continue == (parseError = json_tokener_get_error(tok)));
-		json_tokener_free(tok);
+		return 0;
 	}
-	if(parseError && verbose)
-		fprintf(stderr, "Error parsing JSON: %s\n", json_tokener_error_desc(parseError));
-	json_type type = json_object_get_type(obj);
-	if(*objVarName)
+#endif
+	if(json_type_object == members->type)
 	{
-		static const char * associativeDeclareType = "-A ";
-		static const char * arrayDeclareType = "-a ";
-		char objTypeChar;
-		void printTypeAndBeginObjWithType(const char * declareType)
-		{
-			//  Include a ';' between commands so that this can also be used with eval
-			if(*typeVarName)
-				printf("%s %s=%c;", declareStr, typeVarName, objTypeChar);
-			if(unsetVars)
-				printf("unset %s;", objVarName);
-			printf("%s %s%s=", declareStr, declareType, objVarName);
-		}
-		void printTypeAndBeginObj(void)
-		{
-			printTypeAndBeginObjWithType("");
-		}
-		void printArrayClosureAndBeginArrayVar(const char * declareType)
-		{
-			//  Include a ';' between commands so that this can also be used with eval
-			fputs_unlocked(");", stdout);
-			if(unsetVars)
-				printf("unset %s;", arrayVarName);
-			printf("%s %s%s=(", declareStr, declareType, arrayVarName);
-		}
-		void printObject(void (*valuePrintFunction)(json_object *))
+		if(json_object_iter_equal(&members->objectIterator, &members->objectEnd))
+			return 0;
+		*key = json_object_iter_peek_name(&members->objectIterator);
+		*member = JSON_C_VALUE(json_object_iter_peek_value(&members->objectIterator));
+		json_object_iter_next(&members->objectIterator);
+		return 1;
+	}
+	if(members->index >= members->length)
+		return 0;
+	*key = NULL;
+	*member = JSON_C_VALUE(json_object_array_get_idx(members->array, members->index++));
+	return 1;
+}
+
+
+static size_t arrayLength(jsonValue array)
+{
+#ifdef USE_TAPE_PARSER
+	if(array.entry)
+		return array.entry->count;
+#endif
+	return json_object_array_length(JSON_C_OBJECT(array));
+}
+
+
+//  Return the number of members of an array or object
+static size_t containerLength(jsonValue container)
+{
+#ifdef USE_TAPE_PARSER
+	if(container.entry)
+		return container.entry->count;
+#endif
+	return json_type_object == valueType(container) ?
+		(size_t)json_object_object_length(JSON_C_OBJECT(container)) :
+		json_object_array_length(JSON_C_OBJECT(container));
+}
+
+
+static jsonValue arrayMember(jsonValue array, size_t index)
+{
+#ifdef USE_TAPE_PARSER
+	if(array.entry)
+	{
+		const struct tapeEntry * entry = array.entry + 1;
+		while(index--)
+			entry += entry->size;
+		return TAPE_VALUE(entry);
+	}
+#endif
+	return JSON_C_VALUE(json_object_array_get_idx(JSON_C_OBJECT(array), index));
+}
+
+
+//  Set *member to the value of object's member with key, and return 1, or 0 if there is none
+static int objectMember(jsonValue object, const char * key, jsonValue * member)
+{
+#ifdef USE_TAPE_PARSER
+	if(object.entry)
+	{
+		struct memberIterator members;
+		const char * memberKey;
+		beginMembers(object, &members);
+		while(nextMember(&members, &memberKey, member))
+			if(! strcmp(key, memberKey))
+				return 1;
+		return 0;
+	}
+	return json_object_object_get_ex(JSON_C_OBJECT(object), key, &member->obj);
+#else
+	return json_object_object_get_ex(object, key, member);
+#endif
+}
+
+
+#ifdef USE_TAPE_PARSER
+//  Output the JSON text of a value on the tape, formatted as json-c formats it by default
+static void putTapeJsonText(const struct tapeEntry * entry)
+{
+	switch(entry->type)
+	{
+	case json_type_null:
+		fputs_unlocked("null", output);
+		break;
+	case json_type_string:
+		putc_unlocked('"', output);
+		putJsonEscapedChars(entry->text, entry->length);
+		putc_unlocked('"', output);
+		break;
+	case json_type_array:
+	case json_type_object:
 		{
-		#ifdef TRIM_ARRAY_LEADING_SPACE
-			const char * openBracketStr = "[";
-			const char * const addOpenBracketStr = " [";
-		#else
-			const char * const openBracketStr = " [";
-		#endif
-			json_object_object_foreach(obj, key, val)
+			struct memberIterator members;
+			const char * key;
+			jsonValue member;
+			int isFirstMember = 1;
+			putc_unlocked(json_type_array == entry->type ? '[' : '{', output);
+			beginMembers(TAPE_VALUE(entry), &members);
+			while(nextMember(&members, &key, &member))
 			{
-				if(*key)
-				{
-					fputs_unlocked(openBracketStr, stdout);
-				#ifdef TRIM_ARRAY_LEADING_SPACE
-					openBracketStr = addOpenBracketStr;
-				#endif
-					int keyVal = *key;
-					//  Escape the following characters, newline, tab, and space in the key output:
-					//  !"$'();<>[\]`|  
-					//  () and whitespace need to be escaped for zsh.  Excaping these makes no
-					// difference in bash or ksh.  '#' could also be escaped for better ASCII
-					// grouping in bash and ksh, but not in zsh
-					char * segmentStart = key;
-				#ifdef WORKAROUND_OLD_ZSH_SUBSCRIPT_BUGS
-					//  Old zsh versions are particularly finicky about ", ', ;, <, >, and | characters in array
-					// subscripts.  It is not enough to escape these characters - they must come from either
-					// a variable or command substitution.  $'|' or $'\x7c', for example, do not work.
-					while(
-						(
-							'"' != keyVal && '\'' != keyVal && ';' != keyVal &&
-							'<' != keyVal && '>' != keyVal && '|' != keyVal
-						) ? (
-							(
-								'\t' != keyVal && ' ' != keyVal && '!' != keyVal &&
-								 '$' != keyVal && '(' != keyVal && ')' != keyVal &&
-								//  This range includes '\\'
-								('[' > keyVal || ']' < keyVal) && '`' != keyVal
-							) ? (
-								(keyVal = *(++key)) || ({
-									fwrite_unlocked(segmentStart, key - segmentStart, 1, stdout);
-									0;
-								})
-							) : ({
-								//  Output all characters proceding the character needing escaping, and
-								// then output the escaped character
-								fwrite_unlocked(segmentStart, key - segmentStart, 1, stdout);
-								putc_unlocked('\\', stdout);
-								putc_unlocked(keyVal, stdout);
-								keyVal = *(segmentStart = ++key);
-							})
-						) : ({
-							//  This character requires substitution in zsh.  Output the rest
-							// of the key as a command substitution
-							fputs_unlocked("$(echo ", stdout);
-							putShEscapedString(segmentStart);
-							putc_unlocked(')', stdout);
-							0;
-						})
-					);
-				#else
-					while(
-						(
-							'\t' != keyVal &&
-							//  This range includes '!':
-							(' ' > keyVal || '"' < keyVal) &&
-							'$' != keyVal &&
-							//  This range includes '(':
-							('\'' > keyVal || ')' < keyVal) &&
-							';' != keyVal && '<' != keyVal && '>' != keyVal && 
-							//  This range includes '\\':
-							('[' > keyVal || ']' < keyVal) &&
-							'`' != keyVal && '|' != keyVal
-						) ? (
-							(keyVal = *(++key)) || ({
-								fwrite_unlocked(segmentStart, key - segmentStart, 1, stdout);
-								0;
-							})
-						) : ({
-							//  Output all characters proceding the character needing escaping, and
-							// then output the escaped character
-							fwrite_unlocked(segmentStart, key - segmentStart, 1, stdout);
-							putc_unlocked('\\', stdout);
-							putc_unlocked(keyVal, stdout);
-							keyVal = *(segmentStart = ++key);
-						})
-					);
-				#endif
-					fputs_unlocked("]=", stdout);
-					valuePrintFunction(val);
-				}
-				else if(*emptyKey)
+				fputs_unlocked(isFirstMember ? " " : ", ", output);
+				if(key)
 				{
-					//  Empty keys are valid in JSON but not in shell scripts.
-					// Output emptyKey as the key.
-					fputs_unlocked(openBracketStr, stdout);
-				#ifdef TRIM_ARRAY_LEADING_SPACE
-					openBracketStr = addOpenBracketStr;
-				#endif
-					fputs_unlocked(emptyKey, stdout);
-					fputs_unlocked("]=", stdout);
-					valuePrintFunction(val);
+					putJsonEscapedString(key, 1);
+					fputs_unlocked(": ", output);
 				}
+				putTapeJsonText(member.entry);
+				isFirstMember = 0;
 			}
+			fputs_unlocked(json_type_array == entry->type ? " ]" : " }", output);
 		}
-		switch(type)
-		{
-		case json_type_null: // (i.e. obj == NULL),
-			objTypeChar = 'n';
-			printTypeAndBeginObj();
-			if(quoteStrings)
-				fputs_unlocked("null\n", stdout);
-			else
-				putc_unlocked('\n', stdout);
-			break;
-		case json_type_boolean:
+		break;
+	default:
+		fputs_unlocked(entry->text, output);
+		break;
+	}
+}
+
+
+//  The JSON text returned by tapeJsonText()
+static struct reusedStream tapeJsonStream;
+
+//  Return the JSON text of an array or object on the tape, as json_object_get_string() returns it
+// for json-c's, in a buffer that is reused by the next call
+static const char * tapeJsonText(const struct tapeEntry * entry)
+{
+	FILE * valueOutput = output;
+	output = rewindReusedStream(&tapeJsonStream);
+	putTapeJsonText(entry);
+	putc_unlocked(0, output);
+	fflush_unlocked(output);
+	output = valueOutput;
+	return tapeJsonStream.text;
+}
+#endif
+
+
+//  Return the value as a string, as json_object_get_string() does: the text of a string, JSON text
+// for any other value, or NULL for null
+static const char * valueString(jsonValue val)
+{
+#ifdef USE_TAPE_PARSER
+	if(val.entry)
+		return json_type_array == val.entry->type || json_type_object == val.entry->type ?
+			tapeJsonText(val.entry) : val.entry->text;
+#endif
+	return json_object_get_string(JSON_C_OBJECT(val));
+}
+
+
+#ifndef JKPARSE_BUILTIN
+//  Return the length of the text of a string value, which may include NUL characters
+static size_t stringLength(jsonValue val)
+{
+#ifdef USE_TAPE_PARSER
+	if(val.entry)
+		return val.entry->length;
+#endif
+	return json_object_get_string_len(JSON_C_OBJECT(val));
+}
+
+
+static void valPrintWithQuotedStrings(jsonValue val)
+{
+	json_type type = valueType(val);
+	stats.membersOutput++;
+	if(json_type_null == type)
+		fputs_unlocked("null", output);
+	else
+		(json_type_string == type ? putShEscapedAndQuotedJsonString :
+			putShEscapedString)(valueString(val));
+}
+#endif
+
+
+//  The shells whose fastest form of output may be selected with --shell, rather than the form
+// that all of them evaluate
+enum targetShell
+{
+	SHELL_ANY,
+	SHELL_BASH
+};
+
+//  The forms of output selectable with --format: shell code, or records of each value
+enum outputFormat
+{
+	FORMAT_SHELL,
+	FORMAT_NUL,
+	FORMAT_BINARY
+};
+
+//  Option values.  In server mode, these are reset to the command line's values for each request.
+struct jkparseOptions
+{
+	char * arrayVarName;
+	char * objVarName;
+	char * typeVarName;
+	char * emptyKey;
+	char * flattenSeparator;
+	char flattenEscape;
+	const char * declareStr;
+	int flatten;
+	int indexBase;
+	int editCount;
+	int mergeCount;
+	int encode;
+	int encodeCompact;
+	int multiple;
+	int multipleNumbered;
+	int pathLength;
+	int pathStart;
+	int selectCount;
+	//  The bounds given by --range, as given, with LONG_MIN and LONG_MAX for an omitted start and
+	// end, respectively
+	int range;
+	long rangeStart;
+	long rangeEnd;
+	int printJson;
+	int quoteStrings;
+	int raw;
+	enum targetShell shell;
+	enum outputFormat format;
+	int stream;
+	int stringify;
+	//  With --tree, each array or object nested in the value output is declared as a variable
+	int tree;
+	int unsetVars;
+	int verbose;
+};
+static struct jkparseOptions options = {
+	.arrayVarName = "",
+	.objVarName = "JSON_OBJ",
+	.typeVarName = "JSON_TYPE",
+	.emptyKey = "$'\\1'",
+	.flattenSeparator = ".",
+	.flattenEscape = '\\',
+	.declareStr = "typeset"
+};
+//  The FIFO to read from in server mode, empty for stdin, or NULL when not in server mode
+static const char * serverFifo = NULL;
+//  The file to read input from rather than stdin, or NULL
+static const char * inputFile = NULL;
+//  Key and index path components given by -p.  The first options.pathLength of these are in
+// effect, so that server requests may append to those given on the command line.
+static char ** pathComponents = NULL;
+static int pathCapacity = 0;
+//  Edits given by --set, each of which assigns a value at the path of the -p components preceding
+// it.  The first options.editCount of these are in effect.  The -p components from
+// options.pathStart onward, following the last edit, select the value to output.
+struct jkparseEdit
+{
+	int pathStart;
+	int pathLength;
+	char * value;
+};
+static struct jkparseEdit * edits = NULL;
+static int editCapacity = 0;
+//  The files given by --merge, the first options.mergeCount of which are in effect, and the merge
+// patch parsed from each
+static char ** mergeFiles = NULL;
+static json_object ** mergePatches = NULL;
+static int mergeCapacity = 0;
+//  Keys given by --select, the first options.selectCount of which are in effect, and a hash set of
+// those, with a power of two size, that the key of each member of an object output is looked up in
+static char ** selectedKeys = NULL;
+static int selectCapacity = 0;
+static const char ** selectedKeySet = NULL;
+static size_t selectedKeySetMask = 0;
+#ifndef JKPARSE_BUILTIN
+static const char * associativeDeclareType = "-A ";
+static const char * arrayDeclareType = "-a ";
+//  The name of the array or object variable whose members are being output, which each member's
+// assignment begins with for --shell=bash
+static const char * memberVarName = "";
+#endif
+
+
+//  Return a hash of the NUL terminated key
+static size_t hashKey(const char * key)
+{
+	size_t hash = (size_t)14695981039346656037ULL;
+	while(*key)
+		hash = (hash ^ (unsigned char)*key++) * (size_t)1099511628211ULL;
+	return hash;
+}
+
+
+//  Build selectedKeySet from the keys in effect
+static void buildSelectedKeySet(void)
+{
+	size_t size = 1;
+	while(size < (size_t)options.selectCount * 2)
+		size <<= 1;
+	free(selectedKeySet);
+	if(! (selectedKeySet = calloc(size, sizeof(*selectedKeySet))))
+		exit(EX_OSERR);
+	selectedKeySetMask = size - 1;
+	for(int key = 0; key < options.selectCount; key++)
+	{
+		size_t slot = hashKey(selectedKeys[key]) & selectedKeySetMask;
+		while(selectedKeySet[slot] && strcmp(selectedKeySet[slot], selectedKeys[key]))
+			slot = (slot + 1) & selectedKeySetMask;
+		selectedKeySet[slot] = selectedKeys[key];
+	}
+}
+
+
+//  Return whether an object member with key is output, which it is unless --select is given
+// without it
+static int isKeySelected(const char * key)
+{
+	if(! options.selectCount)
+		return 1;
+	size_t slot = hashKey(key) & selectedKeySetMask;
+	while(selectedKeySet[slot])
+	{
+		if(! strcmp(selectedKeySet[slot], key))
+			return 1;
+		slot = (slot + 1) & selectedKeySetMask;
+	}
+	return 0;
+}
+
+
+//  Return the index in an array of length members for a bound given with --range, limited to
+// the array
+static size_t rangeBound(long bound, size_t length)
+{
+	if(LONG_MIN == bound)
+		return 0;
+	if(LONG_MAX == bound)
+		return length;
+	long index = 0 > bound ? (long)length + bound : bound - options.indexBase;
+	return 0 > index ? 0 : (size_t)index > length ? length : (size_t)index;
+}
+
+
+//  The last word of a variable name option, which may include other declaration arguments
+static const char * lastWord(const char * str)
+{
+	const char * word = strrchr(str, ' ');
+	return word ? word + 1 : str;
+}
+
+
+#ifndef JKPARSE_BUILTIN
+static void printTypeAndBeginObjWithType(char objTypeChar, const char * declareType)
+{
+	//  Include a ';' between commands so that this can also be used with eval
+	if(*options.typeVarName)
+		fprintf(output, "%s %s=%c;", options.declareStr, options.typeVarName, objTypeChar);
+	if(options.unsetVars)
+		fprintf(output, "unset %s;", options.objVarName);
+	fprintf(output, "%s %s%s=", options.declareStr, declareType, options.objVarName);
+}
+
+
+static void printTypeAndBeginObj(char objTypeChar)
+{
+	printTypeAndBeginObjWithType(objTypeChar, "");
+}
+
+
+//  Begin the members of the array or object variable named varName, whose declaration has been
+// output up to its '='.  For --shell=bash, the variable is declared empty, and each member is
+// then assigned by a separate command, which bash evaluates much faster than a single compound
+// assignment of every member.
+static void beginVarMembers(const char * varName)
+{
+	if(SHELL_BASH == options.shell)
+	{
+		fputs_unlocked("()", output);
+		memberVarName = lastWord(varName);
+	}
+	else
+		putc_unlocked('(', output);
+}
+
+
+//  End the members begun by beginVarMembers()
+static void endVarMembers(void)
+{
+	if(SHELL_BASH != options.shell)
+		putc_unlocked(')', output);
+}
+
+
+//  Output what precedes the value of the array member at index
+static void putArrayMemberStart(int index)
+{
+	if(SHELL_BASH == options.shell)
+	{
+		fprintf(output, "\n%s[%d]=", memberVarName, index);
+		return;
+	}
+#ifdef TRIM_ARRAY_LEADING_SPACE
+	if(index)
+#endif
+		putc_unlocked(' ', output);
+}
+
+
+static void printArrayClosureAndBeginArrayVar(const char * declareType)
+{
+	//  Include a ';' between commands so that this can also be used with eval
+	endVarMembers();
+	putc_unlocked(';', output);
+	if(options.unsetVars)
+		fprintf(output, "unset %s;", options.arrayVarName);
+	fprintf(output, "%s %s%s=", options.declareStr, declareType, options.arrayVarName);
+	beginVarMembers(options.arrayVarName);
+}
+
+
+//  Output a non-empty object key for use as an associative array subscript.  Return whether
+// any character needed escaping.
+static int writeShEscapedKey(const char * key)
+{
+	int keyVal = *key;
+	int escaped = 0;
+	//  Escape the following characters, newline, tab, and space in the key output:
+	//  !"$'();<>[\]`|  
+	//  () and whitespace need to be escaped for zsh.  Excaping these makes no
+	// difference in bash or ksh.  '#' could also be escaped for better ASCII
+	// grouping in bash and ksh, but not in zsh
+	const char * segmentStart = key;
+#ifdef WORKAROUND_OLD_ZSH_SUBSCRIPT_BUGS
+	//  Old zsh versions are particularly finicky about ", ', ;, <, >, and | characters in array
+	// subscripts.  It is not enough to escape these characters - they must come from either
+	// a variable or command substitution.  $'|' or $'\x7c', for example, do not work.
+	while(
+		(
+			'"' != keyVal && '\'' != keyVal && ';' != keyVal &&
+			'<' != keyVal && '>' != keyVal && '|' != keyVal
+		) ? (
+			(
+				'\t' != keyVal && ' ' != keyVal && '!' != keyVal &&
+				 '$' != keyVal && '(' != keyVal && ')' != keyVal &&
+				//  This range includes '\\'
+				('[' > keyVal || ']' < keyVal) && '`' != keyVal
+			) ? (
+				(keyVal = *(++key)) || ({
+					fwrite_unlocked(segmentStart, key - segmentStart, 1, output);
+					0;
+				})
+			) : ({
+				//  Output all characters proceding the character needing escaping, and
+				// then output the escaped character
+				fwrite_unlocked(segmentStart, key - segmentStart, 1, output);
+				putc_unlocked('\\', output);
+				putc_unlocked(keyVal, output);
+				escaped = 1;
+				keyVal = *(segmentStart = ++key);
+			})
+		) : ({
+			//  This character requires substitution in zsh.  Output the rest
+			// of the key as a command substitution
+			fputs_unlocked("$(echo ", output);
+			putShEscapedString(segmentStart);
+			putc_unlocked(')', output);
+			escaped = 1;
+			0;
+		})
+	);
+#else
+	while(
+		(
+			'\t' != keyVal &&
+			//  This range includes '!':
+			(' ' > keyVal || '"' < keyVal) &&
+			'$' != keyVal &&
+			//  This range includes '(':
+			('\'' > keyVal || ')' < keyVal) &&
+			';' != keyVal && '<' != keyVal && '>' != keyVal && 
+			//  This range includes '\\':
+			('[' > keyVal || ']' < keyVal) &&
+			'`' != keyVal && '|' != keyVal
+		) ? (
+			(keyVal = *(++key)) || ({
+				fwrite_unlocked(segmentStart, key - segmentStart, 1, output);
+				0;
+			})
+		) : ({
+			//  Output all characters proceding the character needing escaping, and
+			// then output the escaped character
+			fwrite_unlocked(segmentStart, key - segmentStart, 1, output);
+			putc_unlocked('\\', output);
+			putc_unlocked(keyVal, output);
+			escaped = 1;
+			keyVal = *(segmentStart = ++key);
+		})
+	);
+#endif
+	return escaped;
+}
+
+
+static void putShEscapedKey(const char * key)
+{
+	enum statsPhase previousPhase = STATS_PHASE(STATS_ESCAPE_KEYS);
+	stats.escapedKeys += writeShEscapedKey(key);
+	STATS_SET_PHASE(previousPhase);
+}
+
+
+//  Output an object member's subscript and value.  Return 0 without output if the member is
+// excluded because its key is empty and EMPTY_KEY is empty.
+static int printObjectMember(const char * key, jsonValue val,
+	void (*valuePrintFunction)(jsonValue), int isFirstMember)
+{
+	if(! *key && ! *options.emptyKey)
+		return 0;
+	if(SHELL_BASH == options.shell)
+	{
+		putc_unlocked('\n', output);
+		fputs_unlocked(memberVarName, output);
+	}
+#ifdef TRIM_ARRAY_LEADING_SPACE
+	else if(! isFirstMember)
+#else
+	else
+#endif
+		putc_unlocked(' ', output);
+	putc_unlocked('[', output);
+	if(! *key)
+		//  Empty keys are valid in JSON but not in shell scripts.
+		// Output emptyKey as the key.
+		fputs_unlocked(options.emptyKey, output);
+	else
+		putShEscapedKey(key);
+	fputs_unlocked("]=", output);
+	valuePrintFunction(val);
+	return 1;
+}
+
+
+//  Output the members of obj, an array or object, with valuePrintFunction
+static void printMembers(jsonValue obj, void (*valuePrintFunction)(jsonValue))
+{
+	struct memberIterator members;
+	const char * key;
+	jsonValue val;
+	size_t count = containerLength(obj);
+	int isFirstMember = 1;
+	beginMembers(obj, &members);
+	//  With --range, only the members in range are output, as an array of just those
+	if(json_type_array == valueType(obj) && options.range)
+	{
+		size_t rangeStart = rangeBound(options.rangeStart, count);
+		size_t rangeEnd = rangeBound(options.rangeEnd, count);
+		count = rangeEnd > rangeStart ? rangeEnd - rangeStart : 0;
+		for(size_t index = 0; index < rangeStart; index++)
+			nextMember(&members, &key, &val);
+	}
+	for(size_t index = 0; index < count && nextMember(&members, &key, &val); index++)
+	{
+		if(! key)
+		{
+			putArrayMemberStart(index);
+			valuePrintFunction(val);
+		}
+		else if(isKeySelected(key) &&
+			printObjectMember(key, val, valuePrintFunction, isFirstMember))
+			isFirstMember = 0;
+	}
+}
+
+
+static void valPrintWithoutQuotedStrings(jsonValue val)
+{
+	stats.membersOutput++;
+	putShEscapedString(valueString(val));
+}
+
+
+static void arrayValPrintWithoutQuotedStrings(jsonValue objAtIndex)
+{
+	stats.membersOutput++;
+	if(json_type_null == valueType(objAtIndex))
+		fputs_unlocked("''", output);
+	else
+		putShEscapedString(valueString(objAtIndex));
+}
+
+
+static void valTypePrint(jsonValue val)
+{
+	putc_unlocked(*json_type_to_name(valueType(val)), output);
+}
+
+
+static void valTypePrintWithQForStrings(jsonValue val)
+{
+	char typeChar = *json_type_to_name(valueType(val));
+	putc_unlocked('s' == typeChar ? 'q' : typeChar, output);
+}
+#endif
+
+
+//  The key being built for a value output with --flatten
+static char * flattenedKey = NULL;
+static size_t flattenedKeyCapacity = 0;
+
+//  Append length characters of str to the first keyLength characters of flattenedKey, and return
+// the new length
+static size_t appendToFlattenedKey(size_t keyLength, const char * str, size_t length)
+{
+	if(keyLength + length >= flattenedKeyCapacity)
+	{
+		flattenedKeyCapacity = keyLength + length < 128 ? 256 : (keyLength + length) * 2;
+		if(! (flattenedKey = realloc(flattenedKey, flattenedKeyCapacity)))
+			exit(EX_OSERR);
+	}
+	memcpy(flattenedKey + keyLength, str, length);
+	flattenedKey[keyLength + length] = '\0';
+	return keyLength + length;
+}
+
+
+//  Append an object member's key to flattenedKey, preceded by the separator unless it is a key of
+// the top level object, and return the new length.  The escape character is inserted before any occurrence
+// in the key of itself, '[', or the first character of the separator, so that keys containing
+// these are distinguishable from nested paths.
+static size_t appendKeyToFlattenedKey(size_t keyLength, const char * key, int isTopLevel)
+{
+	if(! isTopLevel)
+		keyLength = appendToFlattenedKey(keyLength, options.flattenSeparator,
+			strlen(options.flattenSeparator));
+	const char * segmentStart = key;
+	for(; *key; key++)
+	{
+		if(options.flattenEscape && (options.flattenEscape == *key || '[' == *key ||
+			*options.flattenSeparator == *key))
+		{
+			keyLength = appendToFlattenedKey(keyLength, segmentStart, key - segmentStart);
+			keyLength = appendToFlattenedKey(keyLength, &options.flattenEscape, 1);
+			segmentStart = key;
+		}
+	}
+	return appendToFlattenedKey(keyLength, segmentStart, key - segmentStart);
+}
+
+
+//  Append an array index to flattenedKey, and return the new length
+static size_t appendIndexToFlattenedKey(size_t keyLength, int index)
+{
+	char indexStr[24];
+	return appendToFlattenedKey(keyLength, indexStr,
+		snprintf(indexStr, sizeof(indexStr), "[%d]", index + options.indexBase));
+}
+
+
+#ifndef JKPARSE_BUILTIN
+static void printFlattenedMember(jsonValue val, size_t keyLength,
+	void (*valuePrintFunction)(jsonValue), int * isFirstMember);
+
+//  Output the members nested within container, an array or object, keyed by their paths, the
+// first keyLength characters of which are in flattenedKey, unless container is the top level
+// value.  Return the number of direct members, which is 0 if container is a scalar.
+static int printFlattenedMembers(jsonValue container, size_t keyLength, int isTopLevel,
+	void (*valuePrintFunction)(jsonValue), int * isFirstMember)
+{
+	int memberCount = 0;
+	struct memberIterator members;
+	const char * key;
+	jsonValue val;
+	//  --select and --range apply to the members of the top level value
+	size_t rangeStart = 0;
+	size_t rangeEnd = SIZE_MAX;
+	if(isTopLevel && options.range && json_type_array == valueType(container))
+	{
+		rangeStart = rangeBound(options.rangeStart, arrayLength(container));
+		rangeEnd = rangeBound(options.rangeEnd, arrayLength(container));
+	}
+	beginMembers(container, &members);
+	while(nextMember(&members, &key, &val))
+	{
+		if(isTopLevel && (key ? ! isKeySelected(key) :
+			(size_t)memberCount < rangeStart || (size_t)memberCount >= rangeEnd))
+		{
+			memberCount++;
+			continue;
+		}
+		printFlattenedMember(val, key ? appendKeyToFlattenedKey(keyLength, key, isTopLevel) :
+			appendIndexToFlattenedKey(keyLength, memberCount), valuePrintFunction, isFirstMember);
+		memberCount++;
+	}
+	return memberCount;
+}
+
+
+//  Output val, keyed by the first keyLength characters of flattenedKey, if it is a scalar or an
+// empty array or object, otherwise output its nested members.  *isFirstMember is cleared once a
+// member is output.
+static void printFlattenedMember(jsonValue val, size_t keyLength,
+	void (*valuePrintFunction)(jsonValue), int * isFirstMember)
+{
+	if(printFlattenedMembers(val, keyLength, 0, valuePrintFunction, isFirstMember))
+		return;
+	appendToFlattenedKey(keyLength, "", 0);
+	if(printObjectMember(flattenedKey, val, valuePrintFunction, *isFirstMember))
+		*isFirstMember = 0;
+}
+
+
+//  Output the declarations for obj, an array or object, with --flatten
+static void printFlattenedDeclarations(jsonValue obj, char objTypeChar)
+{
+	int isFirstMember = 1;
+	printTypeAndBeginObjWithType(objTypeChar, associativeDeclareType);
+	beginVarMembers(options.objVarName);
+	printFlattenedMembers(obj, 0, 1, options.quoteStrings ? valPrintWithQuotedStrings :
+		valPrintWithoutQuotedStrings, &isFirstMember);
+	if(*options.arrayVarName)
+	{
+		isFirstMember = 1;
+		printArrayClosureAndBeginArrayVar(associativeDeclareType);
+		printFlattenedMembers(obj, 0, 1, options.quoteStrings ? valTypePrintWithQForStrings :
+			valTypePrint, &isFirstMember);
+	}
+	endVarMembers();
+	putc_unlocked('\n', output);
+}
+
+
+//  With --tree, each array or object nested in the value output is declared as an array or
+// associative array of its own, named by JSON_OBJ followed by an underscore and its number, which
+// the member holds in place of its JSON text.  The nested values are numbered from 1 in the order
+// that they are queued, breadth first, as the members of the value and then of each queued value
+// are output, so that every value is visited once.
+static jsonValue * treeNodes = NULL;
+static size_t treeNodeCount = 0;
+static size_t treeNodeCapacity = 0;
+
+//  If val is an array or object, queue it and output the name of its variable, and return 1,
+// otherwise return 0 without output
+static int putTreeNodeName(jsonValue val)
+{
+	json_type type = valueType(val);
+	if(json_type_array != type && json_type_object != type)
+		return 0;
+	if(treeNodeCount >= treeNodeCapacity)
+	{
+		treeNodeCapacity = treeNodeCapacity ? treeNodeCapacity * 2 : 64;
+		if(! (treeNodes = realloc(treeNodes, treeNodeCapacity * sizeof(*treeNodes))))
+			exit(EX_OSERR);
+	}
+	treeNodes[treeNodeCount++] = val;
+	stats.membersOutput++;
+	fprintf(output, "%s_%zu", lastWord(options.objVarName), treeNodeCount);
+	return 1;
+}
+
+
+static void treeValPrintWithQuotedStrings(jsonValue val)
+{
+	if(! putTreeNodeName(val))
+		valPrintWithQuotedStrings(val);
+}
+
+
+static void treeValPrintWithoutQuotedStrings(jsonValue val)
+{
+	if(! putTreeNodeName(val))
+		valPrintWithoutQuotedStrings(val);
+}
+
+
+static void treeArrayValPrintWithoutQuotedStrings(jsonValue val)
+{
+	if(! putTreeNodeName(val))
+		arrayValPrintWithoutQuotedStrings(val);
+}
+
+
+//  Output the members of node, an array or object, with valuePrintFunction.  As with -f, --select
+// and --range only apply to the members of the top level value.
+static void printTreeMembers(jsonValue node, int isTopLevel, void (*valuePrintFunction)(jsonValue))
+{
+	struct memberIterator members;
+	const char * key;
+	jsonValue val;
+	size_t rangeStart = 0;
+	size_t rangeEnd = SIZE_MAX;
+	int isFirstMember = 1;
+	if(isTopLevel && options.range && json_type_array == valueType(node))
+	{
+		rangeStart = rangeBound(options.rangeStart, arrayLength(node));
+		rangeEnd = rangeBound(options.rangeEnd, arrayLength(node));
+	}
+	beginMembers(node, &members);
+	for(size_t index = 0; nextMember(&members, &key, &val); index++)
+	{
+		if(! key)
+		{
+			if(index < rangeStart || index >= rangeEnd)
+				continue;
+			putArrayMemberStart(index - rangeStart);
+			valuePrintFunction(val);
+		}
+		else if((! isTopLevel || isKeySelected(key)) &&
+			printObjectMember(key, val, valuePrintFunction, isFirstMember))
+			isFirstMember = 0;
+	}
+}
+
+
+//  Output the declarations of node, an array or object, which is the value output if number is 0,
+// otherwise the nested value with that number
+static void printTreeNode(jsonValue node, size_t number)
+{
+	int isArray = json_type_array == valueType(node);
+	const char * declareType = isArray ? arrayDeclareType : associativeDeclareType;
+	char * varNames[] = {options.objVarName, options.arrayVarName};
+	if(! number && *options.typeVarName)
+		fprintf(output, "%s %s=%c;", options.declareStr, options.typeVarName, isArray ? 'a' : 'o');
+	for(int var = 0; number && var < 2; var++)
+		if(*varNames[var] && 0 > asprintf(varNames + var, "%s_%zu", varNames[var], number))
+			exit(EX_OSERR);
+	for(int var = 0; var < 2 && *varNames[var]; var++)
+	{
+		//  Include a ';' between commands so that this can also be used with eval
+		if(var)
+		{
+			endVarMembers();
+			putc_unlocked(';', output);
+		}
+		if(options.unsetVars)
+			fprintf(output, "unset %s;", varNames[var]);
+		fprintf(output, "%s %s%s=", options.declareStr, declareType, varNames[var]);
+		beginVarMembers(varNames[var]);
+		printTreeMembers(node, ! number, var ?
+			(options.quoteStrings ? valTypePrintWithQForStrings : valTypePrint) :
+			options.quoteStrings ? treeValPrintWithQuotedStrings :
+			isArray ? treeArrayValPrintWithoutQuotedStrings : treeValPrintWithoutQuotedStrings);
+	}
+	endVarMembers();
+	putc_unlocked('\n', output);
+	for(int var = 0; number && var < 2; var++)
+		if(*varNames[var])
+			free(varNames[var]);
+}
+
+
+//  Output the declarations for obj, an array or object, with --tree
+static void printTreeDeclarations(jsonValue obj)
+{
+	treeNodeCount = 0;
+	printTreeNode(obj, 0);
+	for(size_t node = 0; node < treeNodeCount; node++)
+		printTreeNode(treeNodes[node], node + 1);
+}
+#endif
+
+
+//  Return the text of a value as JSON_OBJ holds it, which is valid until the next call
+static const char * valueText(jsonValue val)
+{
+	json_type type = valueType(val);
+	if(options.quoteStrings && json_type_string == type)
+		return quotedJsonString(valueString(val));
+	if(json_type_null == type)
+		return options.quoteStrings ? "null" : "";
+	return valueString(val);
+}
+
+
+//  Return the type character of a value as JSON_OBJ_TYPES holds it, with 'q' for a string with -q
+static const char * typeText(jsonValue val)
+{
+	static char typeChar[2];
+	*typeChar = *json_type_to_name(valueType(val));
+	if('s' == *typeChar && options.quoteStrings)
+		*typeChar = 'q';
+	return typeChar;
+}
+
+
+//  The function called by visitMembers() for each member, with its key, or NULL and its index
+typedef void (*memberVisitor)(const char * key, size_t index, jsonValue val);
+
+//  Call visitor for the members nested within container, keyed by their paths, as
+// printFlattenedMembers() outputs them.  Return the number of direct members.
+static int visitFlattenedMembers(jsonValue container, size_t keyLength, int isTopLevel,
+	memberVisitor visitor)
+{
+	int memberCount = 0;
+	struct memberIterator members;
+	const char * key;
+	jsonValue val;
+	size_t rangeStart = 0;
+	size_t rangeEnd = SIZE_MAX;
+	if(isTopLevel && options.range && json_type_array == valueType(container))
+	{
+		rangeStart = rangeBound(options.rangeStart, arrayLength(container));
+		rangeEnd = rangeBound(options.rangeEnd, arrayLength(container));
+	}
+	beginMembers(container, &members);
+	while(nextMember(&members, &key, &val))
+	{
+		if(! isTopLevel || (key ? isKeySelected(key) :
+			(size_t)memberCount >= rangeStart && (size_t)memberCount < rangeEnd))
+		{
+			size_t memberKeyLength = key ? appendKeyToFlattenedKey(keyLength, key, isTopLevel) :
+				appendIndexToFlattenedKey(keyLength, memberCount);
+			if(! visitFlattenedMembers(val, memberKeyLength, 0, visitor))
+			{
+				appendToFlattenedKey(memberKeyLength, "", 0);
+				visitor(flattenedKey, 0, val);
+			}
+		}
+		memberCount++;
+	}
+	return memberCount;
+}
+
+
+//  Call visitor for each member of obj, an array or object, that printMembers() outputs, or with
+// -f, for each nested value that printFlattenedDeclarations() outputs
+static void visitMembers(jsonValue obj, memberVisitor visitor)
+{
+	if(options.flatten)
+	{
+		visitFlattenedMembers(obj, 0, 1, visitor);
+		return;
+	}
+	struct memberIterator members;
+	const char * key;
+	jsonValue val;
+	size_t count = containerLength(obj);
+	beginMembers(obj, &members);
+	if(json_type_array == valueType(obj) && options.range)
+	{
+		size_t rangeStart = rangeBound(options.rangeStart, count);
+		size_t rangeEnd = rangeBound(options.rangeEnd, count);
+		count = rangeEnd > rangeStart ? rangeEnd - rangeStart : 0;
+		for(size_t index = 0; index < rangeStart; index++)
+			nextMember(&members, &key, &val);
+	}
+	for(size_t index = 0; index < count && nextMember(&members, &key, &val); index++)
+	{
+		if(! key || isKeySelected(key))
+			visitor(key, index, val);
+	}
+}
+
+
+#ifndef JKPARSE_BUILTIN
+//  With --format=nul or --format=binary, the value is output as a series of records, each of a
+// key, a type, and a value, with no shell escaping.  The first record is of the value itself,
+// with an empty key, followed by one for each member, keyed as in JSON_OBJ.  For nul, each field
+// is followed by a NUL character, so that a string value is cut off at any NUL character of its
+// own, which -q escapes instead.  For binary, the type character is followed by the key and the
+// value, each preceded by its length as a 64 bit little-endian integer, so that a string value is
+// output in full.
+#define RECORD_BUFFER_SIZE (1 << 16)
+
+static void putRecordLength(size_t length)
+{
+	unsigned char bytes[8];
+	for(int byte = 0; byte < 8; byte++, length >>= 8)
+		bytes[byte] = length & 0xff;
+	fwrite_unlocked(bytes, 1, sizeof(bytes), output);
+}
+
+
+//  Return the text of a value as a record holds it, which is that of valueText(), apart from
+// including any NUL characters of a string, and set *length to its length
+static const char * recordText(jsonValue val, size_t * length)
+{
+	const char * text;
+	if(json_type_string != valueType(val))
+		text = valueText(val);
+	else if(options.quoteStrings)
+		text = quotedJsonChars(valueString(val), stringLength(val));
+	else
+	{
+		*length = stringLength(val);
+		return valueString(val);
+	}
+	*length = strlen(text);
+	return text;
+}
+
+
+//  Output a record, whose value is valueLength characters
+static void printRecord(const char * key, const char * type, const char * value,
+	size_t valueLength)
+{
+	size_t keyLength = strlen(key);
+	if(FORMAT_NUL == options.format)
+	{
+		//  Each field is written with its NUL
+		fwrite_unlocked(key, 1, keyLength + 1, output);
+		fwrite_unlocked(type, 1, 2, output);
+		fwrite_unlocked(value, 1, strlen(value) + 1, output);
+		return;
+	}
+	putc_unlocked(*type, output);
+	putRecordLength(keyLength);
+	fwrite_unlocked(key, 1, keyLength, output);
+	putRecordLength(valueLength);
+	fwrite_unlocked(value, 1, valueLength, output);
+}
+
+
+static void printMemberRecord(const char * key, size_t index, jsonValue val)
+{
+	char indexStr[24];
+	const char * text;
+	size_t length;
+	stats.membersOutput++;
+	if(! key)
+		snprintf(indexStr, sizeof(indexStr), "%zu", index);
+	text = recordText(val, &length);
+	printRecord(key ? key : indexStr, typeText(val), text, length);
+}
+
+
+//  Output the records describing obj
+static void printRecords(jsonValue obj)
+{
+	json_type type = valueType(obj);
+	if(json_type_array != type && json_type_object != type)
+	{
+		size_t length;
+		const char * text = recordText(obj, &length);
+		printRecord("", typeText(obj), text, length);
+		return;
+	}
+	printRecord("", typeText(obj), "", 0);
+	visitMembers(obj, printMemberRecord);
+}
+
+
+//  Output the shell code for the variable declarations describing obj, or its records with --format
+static void printDeclarations(jsonValue obj, int exitCode)
+{
+	json_type type = valueType(obj);
+	if(FORMAT_SHELL != options.format)
+	{
+		printRecords(obj);
+		return;
+	}
+	if(*options.objVarName)
+	{
+		switch(type)
+		{
+		char objTypeChar;
+		case json_type_null: // (i.e. obj == NULL),
+			printTypeAndBeginObj('n');
+			if(options.quoteStrings)
+				fputs_unlocked("null\n", output);
+			else
+				putc_unlocked('\n', output);
+			break;
+		case json_type_boolean:
 			objTypeChar = 'b';
 			goto outputObjPlainly;
 		case json_type_double:
@@ -508,116 +1794,4003 @@ int main(int argc, char **argv)
 			objTypeChar = 'i';
 		outputObjPlainly:
 			//objTypeChar = *json_type_to_name(type);
-			printTypeAndBeginObj();
-			puts(json_object_get_string(obj));
+			printTypeAndBeginObj(objTypeChar);
+			fputs_unlocked(valueString(obj), output);
+			putc_unlocked('\n', output);
+			break;
+		case json_type_object:
+			if(options.flatten)
+			{
+				printFlattenedDeclarations(obj, 'o');
+				break;
+			}
+			if(options.tree)
+			{
+				printTreeDeclarations(obj);
+				break;
+			}
+			printTypeAndBeginObjWithType('o', associativeDeclareType);
+			beginVarMembers(options.objVarName);
+			printMembers(obj, options.quoteStrings ? valPrintWithQuotedStrings :
+				valPrintWithoutQuotedStrings);
+			if(*options.arrayVarName)
+			{
+				printArrayClosureAndBeginArrayVar(associativeDeclareType);
+				printMembers(obj, options.quoteStrings ? valTypePrintWithQForStrings : valTypePrint);
+			}
+			endVarMembers();
+			putc_unlocked('\n', output);
+			break;
+		case json_type_array:
+			if(options.flatten)
+			{
+				printFlattenedDeclarations(obj, 'a');
+				break;
+			}
+			if(options.tree)
+			{
+				printTreeDeclarations(obj);
+				break;
+			}
+			printTypeAndBeginObjWithType('a', arrayDeclareType);
+			beginVarMembers(options.objVarName);
+			printMembers(obj, options.quoteStrings ? valPrintWithQuotedStrings :
+				arrayValPrintWithoutQuotedStrings);
+			if(*options.arrayVarName)
+			{
+				printArrayClosureAndBeginArrayVar(arrayDeclareType);
+				printMembers(obj, options.quoteStrings ? valTypePrintWithQForStrings : valTypePrint);
+			}
+			endVarMembers();
+			putc_unlocked('\n', output);
+			break;
+		case json_type_string:
+			if(options.quoteStrings)
+			{
+				printTypeAndBeginObj('q');
+				putShEscapedAndQuotedJsonString(valueString(obj));
+			}
+			else
+			{
+				printTypeAndBeginObj('s');
+				putShEscapedString(valueString(obj));
+			}
+			putc_unlocked('\n', output);
+			break;
+		}
+	}
+	else if(*options.typeVarName)
+	{
+		char typeChar = *json_type_to_name(type);
+		fprintf(output, "%s %s=%c\n", options.declareStr, options.typeVarName,
+			's' == typeChar && options.quoteStrings ? 'q' : typeChar);
+	}
+	if(exitCode)
+		fprintf(output, "(exit %d)\n", exitCode);
+}
+#endif
+
+
+//  Input read from stdin is processed in chunks of up to this size
+static char inputBuffer[65536];
+
+//  The file that input is read from, which is stdin unless --file names a file that cannot be
+// mapped, such as a pipe
+static int inputFd = 0;
+
+//  Read up to size bytes of inputFd into buffer, and return the length read, 0 at the end of the
+// input, or -1 upon an error
+static ssize_t readInputFd(char * buffer, size_t size)
+{
+	ssize_t readRc;
+	while(-1 == (readRc = read(inputFd, buffer, size)) && EINTR == errno);
+	stats.bytesRead += 0 < readRc ? readRc : 0;
+	return readRc;
+}
+
+
+#ifdef USE_DECOMPRESSION
+//  Input compressed with gzip or zstd, as detected by its magic number, is decompressed as it is
+// read, a chunk at a time, rather than in full before it is parsed.  The compressed input is
+// either read from stdin through compressedBuffer, or is the text of a file mapped by
+// mapInputFile().
+enum compression
+{
+	COMPRESSION_UNDETECTED,
+	COMPRESSION_NONE,
+	COMPRESSION_GZIP,
+	COMPRESSION_ZSTD
+};
+static char compressedBuffer[65536];
+static struct
+{
+	enum compression format;
+	//  The input that has been read but not yet decompressed, and whether the end of the input
+	// follows it
+	const char * in;
+	size_t inLength;
+	int inEnd;
+	//  Whether the last gzip member or zstd frame decompressed is complete, so that the input may
+	// end, or another may follow
+	int frameEnded;
+#ifdef USE_ZLIB
+	z_stream gzip;
+#endif
+#ifdef USE_ZSTD
+	ZSTD_DStream * zstd;
+#endif
+} decompression;
+
+
+//  Read more of stdin into compressedBuffer, following the input not yet decompressed, which is
+// moved to its start.  Return 0, or -1 upon an error.
+static int readCompressedInput(void)
+{
+	if(decompression.inLength)
+		memmove(compressedBuffer, decompression.in, decompression.inLength);
+	decompression.in = compressedBuffer;
+	ssize_t readRc = readInputFd(compressedBuffer + decompression.inLength,
+		sizeof(compressedBuffer) - decompression.inLength);
+	if(0 > readRc)
+		return -1;
+	decompression.inLength += readRc;
+	decompression.inEnd = ! readRc;
+	return 0;
+}
+
+
+//  Return non-zero if the input read so far is too short to tell whether it begins with magic
+static int mayBeginWith(const char * magic, size_t magicLength)
+{
+	return decompression.inLength < magicLength &&
+		! memcmp(decompression.in, magic, decompression.inLength);
+}
+
+//  Return non-zero if the input begins with magic
+static int beginsWith(const char * magic, size_t magicLength)
+{
+	return decompression.inLength >= magicLength && ! memcmp(decompression.in, magic, magicLength);
+}
+
+
+//  The magic numbers that gzip and zstd data begin with
+#define GZIP_MAGIC "\x1f\x8b"
+#define ZSTD_MAGIC "\x28\xb5\x2f\xfd"
+
+//  Detect the format of the input from its first bytes, reading only as many as are needed to tell,
+// and begin decompressing it.  Return 0, or -1 upon an error.
+static int detectCompression(void)
+{
+	while(! decompression.inEnd && (! decompression.in || mayBeginWith(GZIP_MAGIC, 2) ||
+		mayBeginWith(ZSTD_MAGIC, 4)))
+		if(readCompressedInput())
+			return -1;
+	decompression.format = COMPRESSION_NONE;
+	decompression.frameEnded = 1;
+#ifdef USE_ZLIB
+	if(beginsWith(GZIP_MAGIC, 2))
+	{
+		decompression.gzip = (z_stream){0};
+		//  The maximum window size, plus 16 to decode only gzip headers and trailers
+		if(Z_OK != inflateInit2(&decompression.gzip, 15 + 16))
+			exit(EX_OSERR);
+		decompression.format = COMPRESSION_GZIP;
+	}
+#endif
+#ifdef USE_ZSTD
+	if(beginsWith(ZSTD_MAGIC, 4))
+	{
+		if(! decompression.zstd && ! (decompression.zstd = ZSTD_createDStream()))
+			exit(EX_OSERR);
+		ZSTD_initDStream(decompression.zstd);
+		decompression.format = COMPRESSION_ZSTD;
+	}
+#endif
+	return 0;
+}
+
+
+//  Discard the state of decompressing the input, so that the format of the next input is detected
+static void resetDecompression(void)
+{
+#ifdef USE_ZLIB
+	if(COMPRESSION_GZIP == decompression.format)
+		inflateEnd(&decompression.gzip);
+#endif
+	decompression.format = COMPRESSION_UNDETECTED;
+	decompression.in = NULL;
+	decompression.inLength = 0;
+	decompression.inEnd = 0;
+}
+
+
+//  Return 1 if the input following a complete gzip member or zstd frame begins another, reading as
+// much more of it as is needed to tell, 0 if it does not, or -1 upon an error
+static int followedByFrame(void)
+{
+	while(! decompression.inEnd && decompression.inLength < 4)
+		if(readCompressedInput())
+			return -1;
+	if(COMPRESSION_GZIP == decompression.format)
+		return beginsWith(GZIP_MAGIC, 2);
+	//  Skippable frames, whose magic numbers are 0x184D2A50 to 0x184D2A5F, are skipped by
+	// ZSTD_decompressStream()
+	return beginsWith(ZSTD_MAGIC, 4) || (decompression.inLength >= 4 &&
+		0x50 == (decompression.in[0] & 0xf0) && ! memcmp(decompression.in + 1, "\x2a\x4d\x18", 3));
+}
+
+
+//  Report a decompression error with -V, and return -1
+static ssize_t decompressionError(const char * message)
+{
+	if(options.verbose)
+		fprintf(stderr, "Error decompressing input: %s\n", message);
+	errno = EIO;
+	return -1;
+}
+
+
+//  Decompress the next chunk of input into buffer, of up to size bytes, and return its length, 0 at
+// the end of the input, or -1 upon an error.  Input that is not compressed is read as it is.
+static ssize_t decompressInput(char * buffer, size_t size)
+{
+	if(COMPRESSION_UNDETECTED == decompression.format && detectCompression())
+		return -1;
+	if(COMPRESSION_NONE == decompression.format)
+	{
+		//  The bytes read to detect the format are followed by the rest of stdin
+		if(! decompression.inLength)
+			return decompression.inEnd ? 0 : readInputFd(buffer, size);
+		size_t length = size < decompression.inLength ? size : decompression.inLength;
+		memcpy(buffer, decompression.in, length);
+		decompression.in += length;
+		decompression.inLength -= length;
+		return length;
+	}
+	while(1)
+	{
+		//  Anything following the last complete member or frame that does not begin another is
+		// ignored, as gzip -d ignores trailing garbage, so that the tape parser, which reads the
+		// input in full, stops where json-c does
+		if(decompression.frameEnded)
+		{
+			int followed = followedByFrame();
+			if(1 != followed)
+				return followed;
+		}
+		size_t produced = 0;
+		size_t consumed = 0;
+	#ifdef USE_ZLIB
+		if(COMPRESSION_GZIP == decompression.format)
+		{
+			z_stream * gzip = &decompression.gzip;
+			gzip->next_in = (Bytef *)decompression.in;
+			gzip->avail_in = decompression.inLength < UINT_MAX ? decompression.inLength : UINT_MAX;
+			gzip->next_out = (Bytef *)buffer;
+			gzip->avail_out = size < UINT_MAX ? size : UINT_MAX;
+			int inflateRc = inflate(gzip, Z_NO_FLUSH);
+			consumed = (const char *)gzip->next_in - decompression.in;
+			produced = (char *)gzip->next_out - buffer;
+			if(consumed)
+				decompression.frameEnded = 0;
+			//  Concatenated members are decompressed in turn, as by gzip -d
+			if(Z_STREAM_END == inflateRc)
+			{
+				decompression.frameEnded = 1;
+				inflateReset(gzip);
+			}
+			else if(Z_OK != inflateRc && Z_BUF_ERROR != inflateRc)
+				return decompressionError(gzip->msg ? gzip->msg : "invalid gzip data");
+		}
+	#endif
+	#ifdef USE_ZSTD
+		if(COMPRESSION_ZSTD == decompression.format)
+		{
+			ZSTD_inBuffer in = {decompression.in, decompression.inLength, 0};
+			ZSTD_outBuffer out = {buffer, size, 0};
+			size_t zstdRc = ZSTD_decompressStream(decompression.zstd, &out, &in);
+			if(ZSTD_isError(zstdRc))
+				return decompressionError(ZSTD_getErrorName(zstdRc));
+			consumed = in.pos;
+			produced = out.pos;
+			//  A frame is complete and flushed once 0 is returned.  A call that neither consumes nor
+			// produces anything, as at the end of the input, returns the size of a frame header.
+			if(consumed || produced)
+				decompression.frameEnded = ! zstdRc;
+		}
+	#endif
+		decompression.in += consumed;
+		decompression.inLength -= consumed;
+		if(produced)
+			return produced;
+		if(! consumed && ! decompression.inLength)
+		{
+			if(decompression.inEnd)
+				return decompression.frameEnded ? 0 : decompressionError("unexpected end of input");
+			if(readCompressedInput())
+				return -1;
+		}
+	}
+}
+#endif
+
+
+//  Read up to size bytes of input into buffer, decompressed if it is compressed, and return the
+// length read, 0 at the end of the input, or -1 upon an error
+static ssize_t readInputInto(char * buffer, size_t size)
+{
+	enum statsPhase previousPhase = STATS_PHASE(STATS_READ);
+#ifdef USE_DECOMPRESSION
+	ssize_t readRc = decompressInput(buffer, size);
+#else
+	ssize_t readRc = readInputFd(buffer, size);
+#endif
+	STATS_SET_PHASE(previousPhase);
+	return readRc;
+}
+
+
+//  Read the next chunk of input into inputBuffer, and return its length, 0 at the end of the
+// input, or -1 upon an error
+static ssize_t readInput(void)
+{
+	return readInputInto(inputBuffer, sizeof(inputBuffer));
+}
+
+
+//  The input text when it is an argument or a mapped file, including its terminating NUL, which
+// completes a top level number as it does for json_tokener_parse(), or NULL to read from stdin
+static const char * inputText = NULL;
+static size_t inputTextLength = 0;
+//  json_tokener_parse_ex() takes an int length, so a longer inputText is parsed in chunks
+#define MAX_INPUT_CHUNK (1 << 30)
+
+//  Set *chunk to the next chunk of input, and return its length, 0 at the end of the input, or -1
+// upon an error
+static ssize_t nextInput(const char ** chunk)
+{
+	if(! inputText)
+	{
+		*chunk = inputBuffer;
+		return readInput();
+	}
+	size_t length = inputTextLength > MAX_INPUT_CHUNK ? MAX_INPUT_CHUNK : inputTextLength;
+	*chunk = inputText;
+	inputText += length;
+	inputTextLength -= length;
+	return length;
+}
+
+
+#ifdef JKPARSE_BUILTIN
+//  The mapping made by mapInputFile(), which the builtin unmaps once the input has been parsed
+static char * inputMapping = NULL;
+static size_t inputMappingLength = 0;
+#endif
+
+//  Map the file at path into memory as inputText, so that it is parsed without being copied, or if
+// it cannot be mapped, such as for a pipe, read it in place of stdin as inputFd.  Return 0, or the
+// exit code upon failure.
+static int mapInputFile(const char * path)
+{
+	struct stat fileStat;
+#ifdef USE_DECOMPRESSION
+	resetDecompression();
+#endif
+	//  A file read by an earlier call, such as for an earlier group, has been read in full
+	if(inputFd)
+	{
+		close(inputFd);
+		inputFd = 0;
+	}
+	int fd = open(path, O_RDONLY);
+	if(0 > fd || fstat(fd, &fileStat))
+	{
+		fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+		if(0 <= fd)
+			close(fd);
+		return EX_NOINPUT;
+	}
+	//  The file is read from its own descriptor rather than replacing stdin, which the builtin
+	// leaves to the shell
+	if(! S_ISREG(fileStat.st_mode))
+	{
+		inputFd = fd;
+		return EXIT_SUCCESS;
+	}
+	//  The mapping is one byte longer than the file, with the file mapped over the start of an
+	// anonymous mapping, so that the text is NUL terminated even when the file's length is a
+	// multiple of the page size
+	size_t length = fileStat.st_size;
+	char * text = mmap(NULL, length + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(MAP_FAILED == text)
+	{
+		close(fd);
+		return EX_OSERR;
+	}
+	if(length && MAP_FAILED == mmap(text, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0))
+	{
+		fprintf(stderr, "Unable to map %s: %s\n", path, strerror(errno));
+		munmap(text, length + 1);
+		close(fd);
+		return EX_IOERR;
+	}
+	madvise(text, length, MADV_SEQUENTIAL);
+	close(fd);
+#ifdef JKPARSE_BUILTIN
+	inputMapping = text;
+	inputMappingLength = length + 1;
+#endif
+#ifdef USE_DECOMPRESSION
+	//  A compressed file is decompressed from the mapping as it is read, rather than being inputText
+	decompression.in = text;
+	decompression.inLength = length;
+	decompression.inEnd = 1;
+	detectCompression();
+	if(COMPRESSION_NONE != decompression.format)
+	{
+		stats.bytesRead += length;
+		return EXIT_SUCCESS;
+	}
+	resetDecompression();
+#endif
+	inputText = text;
+	inputTextLength = length + 1;
+	//  The file's pages are read as it is parsed, so it is timed as part of the parse
+	stats.bytesRead += length;
+	return EXIT_SUCCESS;
+}
+
+
+//  Append the UTF-8 encoding of codePoint at *out
+static void putUtf8(char ** out, unsigned long codePoint)
+{
+	if(0x80 > codePoint)
+		*((*out)++) = codePoint;
+	else
+	{
+		int length = 0x800 > codePoint ? 2 : 0x10000 > codePoint ? 3 : 4;
+		for(int byte = length - 1; byte > 0; byte--)
+		{
+			(*out)[byte] = 0x80 | (codePoint & 0x3f);
+			codePoint >>= 6;
+		}
+		**out = (0xf00 >> length) | codePoint;
+		*out += length;
+	}
+}
+
+
+//  Read all of stdin into memory as inputText, NUL terminated, though the NUL is not counted in
+// inputTextLength, so that it is not parsed as input by json-c.  Return the length, or -1 upon
+// an error.
+static ssize_t readAllInput(void)
+{
+	char * text = NULL;
+	size_t capacity = 0;
+	size_t length = 0;
+	ssize_t readRc;
+	do
+	{
+		if(capacity - length < sizeof(inputBuffer) + 1)
+		{
+			capacity = capacity ? capacity * 2 : 2 * sizeof(inputBuffer);
+			if(! (text = realloc(text, capacity)))
+				exit(EX_OSERR);
+		}
+		readRc = readInputInto(text + length, capacity - length - 1);
+		length += 0 < readRc ? readRc : 0;
+	}
+	while(0 < readRc);
+	text[length] = '\0';
+	inputText = text;
+	inputTextLength = length;
+	return 0 > readRc ? -1 : (ssize_t)length;
+}
+
+
+//  With --cache-dir, the output for each input and set of options that affect it is kept in a
+// file of the cache directory named by a SHA-256 digest of both.  The file begins with a header
+// holding the length of the output that follows, so that a file that was left incomplete is not
+// used.  Its modification time is updated whenever it is used, and once the files exceed the cache
+// size, the least recently used are removed.
+static const char * cacheDir = NULL;
+static long long cacheSize = 64LL << 20;
+#ifndef JKPARSE_BUILTIN
+#define CACHE_MAGIC "jkparse\n"
+struct cacheHeader
+{
+	char magic[8];
+	uint64_t length;
+};
+//  A cache file being written, with the output written to it also written to the output that
+// was in effect before
+static struct
+{
+	int fd;
+	char * tempPath;
+	char * path;
+	FILE * stream;
+	FILE * output;
+	uint64_t length;
+	int failed;
+} cacheFile = {.fd = -1};
+//  Temporary cache files are named with this prefix, and are removed by a later eviction if they
+// are left for longer than an hour
+#define CACHE_TEMP_PREFIX ".tmp."
+#define CACHE_TEMP_SECONDS 3600
+
+
+//  A SHA-256 digest being computed, as FIPS 180-4 describes.  Cache files are named by a
+// cryptographic digest, so that no input can be crafted to take the place of another's output.
+struct sha256
+{
+	uint32_t state[8];
+	uint64_t length;
+	unsigned char block[64];
+};
+#define SHA256_INIT {{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, \
+	0x1f83d9ab, 0x5be0cd19}, 0, {0}}
+
+static const uint32_t sha256RoundConstants[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+//  Mix a 64 byte block into the state of digest
+static void sha256Block(struct sha256 * digest, const unsigned char * block)
+{
+	#define ROTR32(x, r) (((x) >> (r)) | ((x) << (32 - (r))))
+	uint32_t words[64];
+	uint32_t vars[8];
+	for(int word = 0; word < 16; word++)
+		words[word] = (uint32_t)block[word * 4] << 24 | (uint32_t)block[word * 4 + 1] << 16 |
+			(uint32_t)block[word * 4 + 2] << 8 | block[word * 4 + 3];
+	for(int word = 16; word < 64; word++)
+	{
+		uint32_t w15 = words[word - 15];
+		uint32_t w2 = words[word - 2];
+		words[word] = words[word - 16] + (ROTR32(w15, 7) ^ ROTR32(w15, 18) ^ w15 >> 3) +
+			words[word - 7] + (ROTR32(w2, 17) ^ ROTR32(w2, 19) ^ w2 >> 10);
+	}
+	memcpy(vars, digest->state, sizeof(vars));
+	for(int round = 0; round < 64; round++)
+	{
+		uint32_t t1 = vars[7] + (ROTR32(vars[4], 6) ^ ROTR32(vars[4], 11) ^ ROTR32(vars[4], 25)) +
+			((vars[4] & vars[5]) ^ (~vars[4] & vars[6])) + sha256RoundConstants[round] + words[round];
+		uint32_t t2 = (ROTR32(vars[0], 2) ^ ROTR32(vars[0], 13) ^ ROTR32(vars[0], 22)) +
+			((vars[0] & vars[1]) ^ (vars[0] & vars[2]) ^ (vars[1] & vars[2]));
+		memmove(vars + 1, vars, 7 * sizeof(*vars));
+		vars[4] += t1;
+		vars[0] = t1 + t2;
+	}
+	for(int var = 0; var < 8; var++)
+		digest->state[var] += vars[var];
+	#undef ROTR32
+}
+
+
+//  Add the length bytes at bytes to digest
+static void sha256Update(struct sha256 * digest, const void * bytes, size_t length)
+{
+	const unsigned char * data = bytes;
+	size_t blockLength = digest->length % 64;
+	digest->length += length;
+	if(blockLength)
+	{
+		size_t fill = 64 - blockLength < length ? 64 - blockLength : length;
+		memcpy(digest->block + blockLength, data, fill);
+		data += fill;
+		length -= fill;
+		if(blockLength + fill < 64)
+			return;
+		sha256Block(digest, digest->block);
+	}
+	for(; length >= 64; data += 64, length -= 64)
+		sha256Block(digest, data);
+	memcpy(digest->block, data, length);
+}
+
+
+//  Complete digest, and set hash to its 32 bytes
+static void sha256Final(struct sha256 * digest, unsigned char hash[32])
+{
+	uint64_t bits = digest->length * 8;
+	unsigned char padding[72] = {0x80};
+	//  The padding ends with the length in bits, completing a block
+	size_t paddingLength = (119 - digest->length % 64) % 64 + 1;
+	for(int byte = 0; byte < 8; byte++)
+		padding[paddingLength + byte] = bits >> (56 - 8 * byte);
+	sha256Update(digest, padding, paddingLength + 8);
+	for(int byte = 0; byte < 32; byte++)
+		hash[byte] = digest->state[byte / 4] >> (24 - 8 * (byte % 4));
+}
+
+
+//  Output str to key, preceded by its length, so that the strings of a cache key are unambiguous
+static void putCacheKeyString(FILE * key, const char * str)
+{
+	fprintf(key, "%zu:%s", strlen(str), str);
+}
+
+
+//  Output a description of everything apart from the input that affects the output to key
+static void putCacheKey(FILE * key)
+{
+	const char * locale = setlocale(LC_CTYPE, NULL);
+	putCacheKeyString(key, JKPRINT_VERSION_STRING);
+	putCacheKeyString(key, buildOptions);
+	putCacheKeyString(key, locale ? locale : "");
+#ifdef USE_EXTERNAL_PRINTF
+	//  The locale of printf is that of the environment
+	for(const char * const * name = (const char * const []){"LC_ALL", "LC_CTYPE", "LANG", NULL};
+		*name; name++)
+		putCacheKeyString(key, getenv(*name) ? getenv(*name) : "");
+#endif
+	putCacheKeyString(key, options.arrayVarName);
+	putCacheKeyString(key, options.objVarName);
+	putCacheKeyString(key, options.typeVarName);
+	putCacheKeyString(key, options.emptyKey);
+	putCacheKeyString(key, options.flattenSeparator);
+	putCacheKeyString(key, options.declareStr);
+	fprintf(key, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %ld %ld\n",
+		options.flattenEscape, options.flatten, options.indexBase, options.encode,
+		options.encodeCompact, options.multiple, options.multipleNumbered, options.printJson,
+		options.quoteStrings, options.raw, options.shell, options.format, options.stream,
+		options.stringify, options.tree, options.unsetVars, options.range, options.rangeStart,
+		options.rangeEnd);
+	fprintf(key, "%d %d\n", options.pathStart, options.pathLength);
+	for(int component = 0; component < options.pathLength; component++)
+		putCacheKeyString(key, pathComponents[component]);
+	fprintf(key, "%d\n", options.editCount);
+	for(int edit = 0; edit < options.editCount; edit++)
+	{
+		fprintf(key, "%d %d", edits[edit].pathStart, edits[edit].pathLength);
+		putCacheKeyString(key, edits[edit].value);
+	}
+	fprintf(key, "%d\n", options.selectCount);
+	for(int selected = 0; selected < options.selectCount; selected++)
+		putCacheKeyString(key, selectedKeys[selected]);
+	fprintf(key, "%d\n", options.mergeCount);
+	for(int merge = 0; merge < options.mergeCount; merge++)
+		putCacheKeyString(key, json_object_to_json_string_ext(mergePatches[merge],
+			JSON_C_TO_STRING_PLAIN));
+}
+
+
+//  Write to the cache file and to the output in effect before it, for the output stream used
+// while a cache file is written
+static ssize_t cacheWriteOutput(void * cookie, const char * buffer, size_t size)
+{
+	(void)cookie;
+	if(! cacheFile.failed && writeAll(cacheFile.fd, buffer, size) < size)
+		cacheFile.failed = 1;
+	cacheFile.length += size;
+	return fwrite_unlocked(buffer, 1, size, cacheFile.output) < size ? -1 : (ssize_t)size;
+}
+
+
+struct cacheEntry
+{
+	char name[65];
+	off_t size;
+	struct timespec usedTime;
+};
+
+static int compareCacheEntries(const void * a, const void * b)
+{
+	const struct timespec * aTime = &((const struct cacheEntry *)a)->usedTime;
+	const struct timespec * bTime = &((const struct cacheEntry *)b)->usedTime;
+	if(aTime->tv_sec != bTime->tv_sec)
+		return aTime->tv_sec < bTime->tv_sec ? -1 : 1;
+	return aTime->tv_nsec < bTime->tv_nsec ? -1 : aTime->tv_nsec > bTime->tv_nsec;
+}
+
+
+//  Remove the least recently used cache files until they are within the cache size, along with
+// any temporary files that have been left
+static void evictCache(void)
+{
+	DIR * dir = opendir(cacheDir);
+	struct dirent * dirEntry;
+	struct cacheEntry * entries = NULL;
+	size_t entryCount = 0;
+	size_t entryCapacity = 0;
+	long long totalSize = 0;
+	if(! dir)
+		return;
+	while((dirEntry = readdir(dir)))
+	{
+		struct stat fileStat;
+		const char * name = dirEntry->d_name;
+		int isTemp = ! strncmp(name, CACHE_TEMP_PREFIX, strlen(CACHE_TEMP_PREFIX));
+		if(! isTemp && (64 != strlen(name) || 64 != strspn(name, "0123456789abcdef")))
+			continue;
+		if(fstatat(dirfd(dir), name, &fileStat, AT_SYMLINK_NOFOLLOW) || ! S_ISREG(fileStat.st_mode))
+			continue;
+		if(isTemp)
+		{
+			if(time(NULL) - fileStat.st_mtime > CACHE_TEMP_SECONDS)
+				unlinkat(dirfd(dir), name, 0);
+			continue;
+		}
+		if(entryCount >= entryCapacity)
+		{
+			entryCapacity = entryCapacity ? entryCapacity * 2 : 64;
+			if(! (entries = realloc(entries, entryCapacity * sizeof(*entries))))
+				exit(EX_OSERR);
+		}
+		memcpy(entries[entryCount].name, name, 65);
+		entries[entryCount].size = fileStat.st_size;
+		entries[entryCount++].usedTime = fileStat.st_mtim;
+		totalSize += fileStat.st_size;
+	}
+	if(totalSize > cacheSize)
+	{
+		qsort(entries, entryCount, sizeof(*entries), compareCacheEntries);
+		for(size_t entry = 0; entry < entryCount && totalSize > cacheSize; entry++)
+		{
+			unlinkat(dirfd(dir), entries[entry].name, 0);
+			totalSize -= entries[entry].size;
+		}
+	}
+	free(entries);
+	closedir(dir);
+}
+
+
+//  Complete the cache file at exit, moving it into place if the output is complete and the exit
+// code is 0, or otherwise remove it
+static void finishCacheFile(int status, void * arg)
+{
+	(void)arg;
+	struct cacheHeader header = {CACHE_MAGIC, 0};
+	if(! status && (fflush_unlocked(cacheFile.stream) || fflush_unlocked(cacheFile.output)))
+		status = EX_IOERR;
+	header.length = cacheFile.length;
+	if(status || cacheFile.failed || sizeof(header) != pwrite(cacheFile.fd, &header,
+		sizeof(header), 0) || rename(cacheFile.tempPath, cacheFile.path))
+	{
+		unlink(cacheFile.tempPath);
+		close(cacheFile.fd);
+		return;
+	}
+	close(cacheFile.fd);
+	evictCache();
+}
+
+
+//  Create cacheDir if necessary, with access for the user only, and return NULL if it may be used,
+// otherwise the reason that it may not.  Since its files are output as shell code to be evaluated,
+// it must be a directory owned by the effective user that no one else may write to.
+static const char * checkCacheDir(void)
+{
+	struct stat dirStat;
+	if((mkdir(cacheDir, 0700) && EEXIST != errno) || stat(cacheDir, &dirStat))
+		return strerror(errno);
+	if(! S_ISDIR(dirStat.st_mode))
+		return strerror(ENOTDIR);
+	if(dirStat.st_uid != geteuid())
+		return "it is not owned by the user";
+	if(dirStat.st_mode & (S_IWGRP | S_IWOTH))
+		return "it is writable by others";
+	return NULL;
+}
+
+
+static int outputResult(jsonValue obj, enum json_tokener_error parseError);
+
+//  Output the cached output for the input and options, if there is any, and return 0.  Otherwise,
+// begin writing the output to a new cache file, and return -1.  The input is read in full first,
+// as inputText, and an error reading it is output as it is without --cache-dir, with its exit code
+// returned.  A cache that cannot be used is only reported with -V.
+static int useCache(void)
+{
+	enum statsPhase previousPhase;
+	struct sha256 digest = SHA256_INIT;
+	unsigned char hash[32];
+	const char * dirError;
+	char * key = NULL;
+	size_t keyLength = 0;
+	FILE * keyStream;
+	int fd;
+	struct stat fileStat;
+	if(! inputText && 0 > readAllInput())
+	{
+		if(options.verbose)
+			fprintf(stderr, "Error reading input: %s\n", strerror(errno));
+		return options.stringify || options.encode || options.multiple ? EX_IOERR :
+			outputResult(JSON_C_VALUE(NULL), json_tokener_error_parse_eof);
+	}
+	previousPhase = STATS_PHASE(STATS_READ);
+	if(! (keyStream = open_memstream(&key, &keyLength)))
+		exit(EX_OSERR);
+	putCacheKey(keyStream);
+	fclose(keyStream);
+	//  The key is self-delimiting, so that the input simply follows it
+	sha256Update(&digest, key, keyLength);
+	sha256Update(&digest, inputText, inputTextLength);
+	sha256Final(&digest, hash);
+	free(key);
+	if((dirError = checkCacheDir()))
+	{
+		if(options.verbose)
+			fprintf(stderr, "Unable to use the cache in %s: %s\n", cacheDir, dirError);
+		STATS_SET_PHASE(previousPhase);
+		return -1;
+	}
+	if(! (cacheFile.path = malloc(strlen(cacheDir) + 2 * sizeof(hash) + 2)))
+		exit(EX_OSERR);
+	char * name = cacheFile.path + sprintf(cacheFile.path, "%s/", cacheDir);
+	for(size_t byte = 0; byte < sizeof(hash); byte++)
+		name += sprintf(name, "%02x", hash[byte]);
+	//  A cache file is only used if it was written by the user
+	if(0 <= (fd = open(cacheFile.path, O_RDONLY | O_NOFOLLOW)))
+	{
+		struct cacheHeader * header;
+		if(! fstat(fd, &fileStat) && S_ISREG(fileStat.st_mode) && fileStat.st_uid == geteuid() &&
+			(size_t)fileStat.st_size >= sizeof(*header) &&
+			MAP_FAILED != (header = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0)))
+		{
+			if(! memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) &&
+				header->length == fileStat.st_size - sizeof(*header))
+			{
+				//  The cache file is used, so it is now the most recently used
+				futimens(fd, NULL);
+				close(fd);
+				STATS_SET_PHASE(STATS_OUTPUT);
+				fwrite_unlocked(header + 1, 1, header->length, output);
+				STATS_SET_PHASE(previousPhase);
+				return EXIT_SUCCESS;
+			}
+			munmap(header, fileStat.st_size);
+		}
+		close(fd);
+	}
+	STATS_SET_PHASE(previousPhase);
+	//  The output is written to a new temporary file, which replaces the cache file at exit
+	if(0 > asprintf(&cacheFile.tempPath, "%s/" CACHE_TEMP_PREFIX "XXXXXX", cacheDir))
+		exit(EX_OSERR);
+	if(0 > (cacheFile.fd = mkstemp(cacheFile.tempPath)) ||
+		sizeof(struct cacheHeader) != write(cacheFile.fd, &(struct cacheHeader){CACHE_MAGIC, 0},
+			sizeof(struct cacheHeader)))
+	{
+		if(options.verbose)
+			fprintf(stderr, "Unable to write to the cache in %s: %s\n", cacheDir, strerror(errno));
+		if(0 <= cacheFile.fd)
+		{
+			unlink(cacheFile.tempPath);
+			close(cacheFile.fd);
+		}
+		return -1;
+	}
+	cacheFile.output = output;
+	if(! (output = cacheFile.stream = fopencookie(NULL, "w",
+		(cookie_io_functions_t){.write = cacheWriteOutput})))
+		exit(EX_OSERR);
+	__fsetlocking(output, FSETLOCKING_BYCALLER);
+	on_exit(finishCacheFile, NULL);
+	return -1;
+}
+#endif
+
+
+#ifdef USE_TAPE_PARSER
+//  The tape that documents are parsed into by the built-in parser.  Its storage is reused for each
+// document that a server parses.
+static struct
+{
+	struct tapeEntry * entries;
+	size_t length;
+	size_t capacity;
+	//  The decoded text of keys, strings, and numbers.  Decoding never lengthens the text of a
+	// value, and each value's NUL fits in the space of its quotes or of the delimiter following it,
+	// so this needs no more space than the document.
+	char * text;
+	size_t textLength;
+	size_t textCapacity;
+	//  A hash table of the indices of the keys of an object, for finding repeated keys
+	size_t * keys;
+	size_t keysCapacity;
+} tape;
+
+//  Append an entry of type to the tape, and return its index
+static size_t tapeAppend(json_type type)
+{
+	if(tape.length == tape.capacity)
+	{
+		tape.capacity = tape.capacity ? tape.capacity * 2 : 4096;
+		if(! (tape.entries = realloc(tape.entries, tape.capacity * sizeof(*tape.entries))))
+			exit(EX_OSERR);
+	}
+	tape.entries[tape.length] = (struct tapeEntry){.type = type, .size = 1};
+	return tape.length++;
+}
+
+
+//  Only the whitespace of RFC 8259 is accepted.  json-c treats some other characters differently.
+static const char * tapeSkipWhitespace(const char * pos)
+{
+	while(' ' == *pos || '\n' == *pos || '\r' == *pos || '\t' == *pos)
+		pos++;
+	return pos;
+}
+
+
+//  Return the code unit of the 4 hex digits at pos, or -1 if they are not hex digits
+static long tapeParseCodeUnit(const char * pos)
+{
+	long codeUnit = 0;
+	for(int digit = 0; 4 > digit; digit++, pos++)
+	{
+		if(! isxdigit((unsigned char)*pos))
+			return -1;
+		codeUnit = (codeUnit << 4) | (isdigit((unsigned char)*pos) ? *pos - '0' :
+			(*pos | 0x20) - 'a' + 10);
+	}
+	return codeUnit;
+}
+
+
+//  Decode the string following the opening quote at pos into the tape's text for the entry at
+// index.  Return the position following its closing quote, or NULL if it is not accepted.
+// Unpaired surrogate escapes are left to json-c, which substitutes a replacement character.
+static const char * tapeParseString(const char * pos, const char * end, size_t index)
+{
+	char * decoded = tape.text + tape.textLength;
+	char * out = decoded;
+	while(1)
+	{
+		//  Runs of characters that need no decoding are copied a word at a time
+		for(; pos + sizeof(uint64_t) <= end; pos += sizeof(uint64_t), out += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, pos, sizeof(word));
+			if(WORD_HAS_BYTE(word, '"') | WORD_HAS_BYTE(word, '\\') | WORD_HAS_BYTE(word, 0))
+				break;
+			memcpy(out, &word, sizeof(word));
+		}
+		char c = *pos;
+		if('"' == c)
+			break;
+		if(! c)
+			return NULL;
+		if('\\' != c)
+		{
+			*out++ = c;
+			pos++;
+			continue;
+		}
+		switch((c = pos[1]))
+		{
+		case '"':
+		case '\\':
+		case '/':
+			*out++ = c;
+			break;
+		case 'b':
+			*out++ = '\b';
+			break;
+		case 'f':
+			*out++ = '\f';
+			break;
+		case 'n':
+			*out++ = '\n';
+			break;
+		case 'r':
+			*out++ = '\r';
+			break;
+		case 't':
+			*out++ = '\t';
+			break;
+		case 'u':
+			{
+				long codePoint = tapeParseCodeUnit(pos + 2);
+				if(0xD800 <= codePoint && 0xDBFF >= codePoint)
+				{
+					long lowSurrogate = '\\' == pos[6] && 'u' == pos[7] ?
+						tapeParseCodeUnit(pos + 8) : -1;
+					if(0xDC00 > lowSurrogate || 0xDFFF < lowSurrogate)
+						return NULL;
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + lowSurrogate - 0xDC00;
+					pos += 6;
+				}
+				else if(0 > codePoint || (0xDC00 <= codePoint && 0xDFFF >= codePoint))
+					return NULL;
+				putUtf8(&out, codePoint);
+				pos += 4;
+			}
+			break;
+		default:
+			return NULL;
+		}
+		pos += 2;
+	}
+	*out = '\0';
+	tape.entries[index].text = decoded;
+	tape.entries[index].length = out - decoded;
+	tape.textLength += out - decoded + 1;
+	return pos + 1;
+}
+
+
+//  Parse the number at pos for the entry at index, and return the position following it, or NULL
+// if it is not accepted.  The text of an integer is as json-c outputs it: -0 is 0, and integers
+// beyond the range of 64 bits are clamped.  Other numbers keep their original text.
+static const char * tapeParseNumber(const char * pos, size_t index)
+{
+	const char * start = pos;
+	struct tapeEntry * entry = tape.entries + index;
+	if('-' == *pos)
+		pos++;
+	if('0' == *pos)
+		pos++;
+	else if(isdigit((unsigned char)*pos))
+		while(isdigit((unsigned char)*++pos));
+	else
+		return NULL;
+	if('.' == *pos)
+	{
+		entry->type = json_type_double;
+		if(! isdigit((unsigned char)*++pos))
+			return NULL;
+		while(isdigit((unsigned char)*++pos));
+	}
+	if('e' == (*pos | 0x20))
+	{
+		entry->type = json_type_double;
+		if('+' == *++pos || '-' == *pos)
+			pos++;
+		if(! isdigit((unsigned char)*pos))
+			return NULL;
+		while(isdigit((unsigned char)*++pos));
+	}
+	char * text = tape.text + tape.textLength;
+	size_t length = pos - start;
+	if(json_type_int == entry->type && (19 <= length || ('-' == *start && '0' == start[1])))
+		length = '-' == *start ? sprintf(text, "%lld", strtoll(start, NULL, 10)) :
+			sprintf(text, "%llu", strtoull(start, NULL, 10));
+	else
+	{
+		memcpy(text, start, length);
+		text[length] = '\0';
+	}
+	entry->text = text;
+	tape.textLength += length + 1;
+	return pos;
+}
+
+
+//  Find the repeated keys among the count members of the object at index, and resolve them as
+// json-c does.  Return the number of members with repeated keys.
+static size_t tapeResolveRepeatedKeys(size_t index, size_t count)
+{
+	size_t repeatCount = 0;
+	size_t mask = 1;
+	while(mask < count * 2)
+		mask <<= 1;
+	if(mask > tape.keysCapacity)
+	{
+		tape.keysCapacity = mask;
+		free(tape.keys);
+		if(! (tape.keys = malloc(mask * sizeof(*tape.keys))))
+			exit(EX_OSERR);
+	}
+	//  Index 0 is the top level value, never a key, so it marks an empty slot
+	memset(tape.keys, 0, mask * sizeof(*tape.keys));
+	mask--;
+	struct tapeEntry * entries = tape.entries;
+	for(size_t key = index + 1; count--; key += 1 + entries[key + 1].size)
+	{
+		size_t slot = hashKey(entries[key].text) & mask;
+		while(tape.keys[slot] && strcmp(entries[tape.keys[slot]].text, entries[key].text))
+			slot = (slot + 1) & mask;
+		if(tape.keys[slot])
+		{
+			entries[tape.keys[slot]].value = key + 1 - tape.keys[slot];
+			entries[key].value = 0;
+			repeatCount++;
+		}
+		else
+			tape.keys[slot] = key;
+	}
+	return repeatCount;
+}
+
+
+static const char * tapeParseValue(const char * pos, const char * end, int depth);
+
+//  Parse the array or object at pos, and return the position following it, or NULL if it is not
+// accepted
+static const char * tapeParseContainer(const char * pos, const char * end, int depth)
+{
+	int isObject = '{' == *pos;
+	char closingChar = isObject ? '}' : ']';
+	size_t index = tapeAppend(isObject ? json_type_object : json_type_array);
+	size_t count = 0;
+	pos = tapeSkipWhitespace(pos + 1);
+	if(closingChar != *pos)
+		while(1)
+		{
+			if(isObject)
+			{
+				if('"' != *pos)
+					return NULL;
+				size_t key = tapeAppend(json_type_string);
+				if(! (pos = tapeParseString(pos + 1, end, key)))
+					return NULL;
+				tape.entries[key].value = 1;
+				pos = tapeSkipWhitespace(pos);
+				if(':' != *pos)
+					return NULL;
+				pos = tapeSkipWhitespace(pos + 1);
+			}
+			if(! (pos = tapeParseValue(pos, end, depth + 1)))
+				return NULL;
+			count++;
+			pos = tapeSkipWhitespace(pos);
+			if(',' == *pos)
+				pos = tapeSkipWhitespace(pos + 1);
+			else if(closingChar == *pos)
+				break;
+			else
+				return NULL;
+		}
+	if(isObject && 1 < count)
+		count -= tapeResolveRepeatedKeys(index, count);
+	tape.entries[index].size = tape.length - index;
+	tape.entries[index].count = count;
+	return pos + 1;
+}
+
+
+//  Parse the value at pos, and return the position following it, or NULL if it is not accepted
+static const char * tapeParseValue(const char * pos, const char * end, int depth)
+{
+	static const char * const literals[] = {"null", "true", "false"};
+	int literal;
+	size_t index;
+	//  Anything nested more deeply is left to json-c, to fail at its depth limit
+	if(JSON_TOKENER_DEFAULT_DEPTH <= depth)
+		return NULL;
+	switch(*pos)
+	{
+	case '[':
+	case '{':
+		return tapeParseContainer(pos, end, depth);
+	case '"':
+		return tapeParseString(pos + 1, end, tapeAppend(json_type_string));
+	case 'n':
+		literal = 0;
+		break;
+	case 't':
+		literal = 1;
+		break;
+	case 'f':
+		literal = 2;
+		break;
+	default:
+		return tapeParseNumber(pos, tapeAppend(json_type_int));
+	}
+	size_t length = strlen(literals[literal]);
+	if(strncmp(pos, literals[literal], length))
+		return NULL;
+	index = tapeAppend(literal ? json_type_boolean : json_type_null);
+	tape.entries[index].text = literal ? literals[literal] : NULL;
+	return pos + length;
+}
+
+
+//  Parse the length characters of text, which must be followed by a NUL, onto the tape.  Return
+// the document's value, or a json-c null if the text is not accepted, for it to be parsed by
+// json-c instead.  Only arrays and objects are accepted, since whether a top level scalar is
+// complete at the end of the input is particular to how json-c reads the input.
+static jsonValue tapeParse(const char * text, size_t length)
+{
+	const char * end = text + length;
+	tape.length = tape.textLength = 0;
+	if(length + 1 > tape.textCapacity)
+	{
+		tape.textCapacity = length + 1;
+		free(tape.text);
+		if(! (tape.text = malloc(tape.textCapacity)))
+			exit(EX_OSERR);
+	}
+	const char * pos = tapeSkipWhitespace(text);
+	if(('[' == *pos || '{' == *pos) && (pos = tapeParseContainer(pos, end, 0)) &&
+		tapeSkipWhitespace(pos) == end)
+		return TAPE_VALUE(tape.entries);
+	return JSON_C_VALUE(NULL);
+}
+
+
+#ifndef JKPARSE_BUILTIN
+//  Set aside the tape's storage, other than its hash table of keys, so that the values of the
+// document last parsed remain valid while further documents are parsed onto a new tape
+static void keepTape(void)
+{
+	size_t * keys = tape.keys;
+	size_t keysCapacity = tape.keysCapacity;
+	memset(&tape, 0, sizeof(tape));
+	tape.keys = keys;
+	tape.keysCapacity = keysCapacity;
+}
+#endif
+#endif
+
+
+//  Parse pathComponent as an index of array.  Indices are offset by options.indexBase, unless
+// negative, in which case they count back from the end of the array as they do in shells.  Return
+// the index, which may be beyond the end of the array, or -1 if it is not a valid index.
+static long parseArrayIndex(jsonValue array, const char * pathComponent)
+{
+	char * end;
+	errno = 0;
+	long index = strtol(pathComponent, &end, 10);
+	if(errno || ! *pathComponent || *end)
+		return -1;
+	index = 0 > index ? (long)arrayLength(array) + index : index - options.indexBase;
+	return 0 > index ? -1 : index;
+}
+
+
+//  Follow length path components from start, starting from obj, and set *target to the value
+// reached.  Return -1 if the whole path could be followed, otherwise the index of the first
+// component that could not be, with *target set to the value that it could not be followed from.
+static int followPath(jsonValue obj, int start, int length, jsonValue * target)
+{
+	*target = obj;
+	for(int component = start; component < start + length; component++)
+	{
+		const char * pathComponent = pathComponents[component];
+		switch(valueType(*target))
+		{
+		case json_type_object:
+			if(! objectMember(*target, pathComponent, &obj))
+				return component;
+			break;
+		case json_type_array:
+			{
+				long index = parseArrayIndex(*target, pathComponent);
+				if(0 > index || index >= (long)arrayLength(*target))
+					return component;
+				obj = arrayMember(*target, index);
+			}
+			break;
+		default:
+			return component;
+		}
+		*target = obj;
+	}
+	return -1;
+}
+
+
+//  Apply the edits in effect to obj.  Return 0, or upon failure, the same exit code that
+// libjkparse.sh's jkparseSet() has always returned: 1 if the value at a path is not an array or
+// object, json_tokener_error_parse_eof if the value at a path does not exist, or the error from
+// parsing the new value.
+static int applyEdits(json_object * obj)
+{
+	for(const struct jkparseEdit * edit = edits; edit < edits + options.editCount; edit++)
+	{
+		jsonValue container;
+		int lastComponent = edit->pathStart + edit->pathLength - 1;
+		int missingComponent = followPath(JSON_C_VALUE(obj), edit->pathStart,
+			edit->pathLength - 1, &container);
+		json_type type = valueType(container);
+		int isContainer = json_type_object == type || json_type_array == type;
+		if(-1 != missingComponent)
+		{
+			if(options.verbose)
+				fprintf(stderr, "%s at path component %d: %s\n", isContainer ? "No value" :
+					"Not an array or object", missingComponent + 1, pathComponents[missingComponent]);
+			return isContainer ? json_tokener_error_parse_eof : EXIT_FAILURE;
+		}
+		long index = json_type_array == type ?
+			parseArrayIndex(container, pathComponents[lastComponent]) : 0;
+		if(! isContainer || 0 > index)
+		{
+			if(options.verbose)
+				fprintf(stderr, "%s at path component %d: %s\n", 0 > index ? "Invalid index" :
+					"Not an array or object", lastComponent + 1, pathComponents[lastComponent]);
+			return EXIT_FAILURE;
+		}
+		enum json_tokener_error parseError;
+		json_object * value = json_tokener_parse_verbose(edit->value, &parseError);
+		if(parseError)
+		{
+			if(options.verbose)
+				fprintf(stderr, "Error parsing JSON to set: %s\n",
+					json_tokener_error_desc(parseError));
+			return parseError;
+		}
+		//  An index beyond the end of an array extends it, with null values in any gap
+		if(json_type_object == type ? json_object_object_add(JSON_C_OBJECT(container),
+			pathComponents[lastComponent], value) :
+			json_object_array_put_idx(JSON_C_OBJECT(container), index, value))
+			return EX_OSERR;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+//  Parse the file of each --merge option.  Return 0, or the exit code upon failure, in which case
+// there is no output.
+static int loadMergePatches(void)
+{
+	char * text = NULL;
+	size_t size = 0;
+	for(int merge = 0; merge < options.mergeCount; merge++)
+	{
+		FILE * file = fopen(mergeFiles[merge], "r");
+		if(! file)
+		{
+			fprintf(stderr, "Unable to open %s: %s\n", mergeFiles[merge], strerror(errno));
+			free(text);
+			return EX_NOINPUT;
+		}
+		//  JSON text contains no NUL characters, so the whole file is read as a single delimited
+		// record
+		ssize_t length = getdelim(&text, &size, 0, file);
+		int readError = ferror(file);
+		fclose(file);
+		if(readError)
+		{
+			fprintf(stderr, "Error reading %s: %s\n", mergeFiles[merge], strerror(errno));
+			free(text);
+			return EX_IOERR;
+		}
+		stats.bytesRead += 0 < length ? length : 0;
+		enum json_tokener_error parseError;
+		mergePatches[merge] = json_tokener_parse_verbose(0 < length ? text : "", &parseError);
+		if(parseError)
+		{
+			fprintf(stderr, "Error parsing %s: %s\n", mergeFiles[merge],
+				json_tokener_error_desc(parseError));
+			free(text);
+			return parseError;
+		}
+	}
+	free(text);
+	return EXIT_SUCCESS;
+}
+
+
+static json_object * patchedValue(json_object * patch);
+
+//  Apply patch to the object target in place, as a JSON merge patch as RFC 7396 describes: each of
+// its members with a null value removes the member of target with the same key, and each other
+// replaces it, or when both are objects, is merged into it likewise.  Values taken from patch are
+// copied, so that it is left unmodified.
+static void mergeObjectPatch(json_object * target, json_object * patch)
+{
+	json_object_object_foreach(patch, key, value)
+	{
+		json_object * member;
+		if(! value)
+			json_object_object_del(target, key);
+		else if(json_object_is_type(value, json_type_object) &&
+			json_object_object_get_ex(target, key, &member) &&
+			json_object_is_type(member, json_type_object))
+			mergeObjectPatch(member, value);
+		else if(json_object_object_add(target, key, patchedValue(value)))
+			exit(EX_OSERR);
+	}
+}
+
+
+//  Return a new value that is the result of applying patch to a value that is not an object: a copy
+// of patch, without the null members of any objects
+static json_object * patchedValue(json_object * patch)
+{
+	json_object * value = NULL;
+	if(json_object_is_type(patch, json_type_object))
+	{
+		if(! (value = json_object_new_object()))
+			exit(EX_OSERR);
+		mergeObjectPatch(value, patch);
+	}
+	else if(patch && json_object_deep_copy(patch, &value, NULL))
+		exit(EX_OSERR);
+	return value;
+}
+
+
+//  Return a reference to the result of applying each --merge patch to obj in turn, which is obj
+// itself, modified in place, if it and each patch are objects
+static json_object * applyMergePatches(json_object * obj)
+{
+	json_object * merged = json_object_get(obj);
+	for(int merge = 0; merge < options.mergeCount; merge++)
+	{
+		if(json_object_is_type(merged, json_type_object) &&
+			json_object_is_type(mergePatches[merge], json_type_object))
+			mergeObjectPatch(merged, mergePatches[merge]);
+		else
+		{
+			json_object_put(merged);
+			merged = patchedValue(mergePatches[merge]);
+		}
+	}
+	return merged;
+}
+
+
+//  Output obj as JSON text, without a trailing newline
+static void printJsonText(jsonValue obj)
+{
+	json_type type = valueType(obj);
+#ifdef USE_TAPE_PARSER
+	if(obj.entry && json_type_string != type)
+		putTapeJsonText(obj.entry);
+	else
+#endif
+	if(json_type_string == type)
+		putJsonEscapedString(valueString(obj), 1);
+	else if(json_type_null != type)
+		fputs_unlocked(valueString(obj), output);
+	else
+		fputs_unlocked("null", output);
+}
+
+
+#ifdef JKPARSE_BUILTIN
+//  The bash builtin assigns the variables itself, rather than outputting their declarations
+static void assignVariables(jsonValue obj, int exitCode);
+#define declareVariables assignVariables
+#else
+#define declareVariables printDeclarations
+#endif
+
+//  Output the result of parsing, according to the options in effect, and return the exit code
+static int outputResult(jsonValue obj, enum json_tokener_error parseError)
+{
+	if(parseError)
+	{
+		if(options.verbose)
+			fprintf(stderr, "Error parsing JSON: %s\n", json_tokener_error_desc(parseError));
+		if(! options.printJson)
+			declareVariables(JSON_C_VALUE(NULL), parseError);
+		return parseError;
+	}
+	if(options.mergeCount)
+	{
+		//  The merged value is output in place of obj, which is left to its owner to release
+		int mergeCount = options.mergeCount;
+		json_object * merged = applyMergePatches(JSON_C_OBJECT(obj));
+		options.mergeCount = 0;
+		int rc = outputResult(JSON_C_VALUE(merged), parseError);
+		options.mergeCount = mergeCount;
+		json_object_put(merged);
+		return rc;
+	}
+	if(options.editCount)
+	{
+		int editRc = applyEdits(JSON_C_OBJECT(obj));
+		if(editRc)
+		{
+			if(! options.printJson)
+				declareVariables(JSON_C_VALUE(NULL), editRc);
+			return editRc;
+		}
+	}
+	if(options.pathLength > options.pathStart)
+	{
+		int missingComponent = followPath(obj, options.pathStart,
+			options.pathLength - options.pathStart, &obj);
+		if(-1 != missingComponent)
+		{
+			if(options.verbose)
+				fprintf(stderr, "No value at path component %d: %s\n", missingComponent + 1,
+					pathComponents[missingComponent]);
+			if(! options.printJson)
+				declareVariables(JSON_C_VALUE(NULL), EX_DATAERR);
+			return EX_DATAERR;
+		}
+	}
+	enum statsPhase previousPhase = STATS_PHASE(STATS_OUTPUT);
+	if(options.printJson)
+		printJsonText(obj);
+	else
+		declareVariables(obj, 0);
+	STATS_SET_PHASE(previousPhase);
+	return EXIT_SUCCESS;
+}
+
+
+//  Parse the whole input with json-c, and return the parsed object, or NULL with *parseError set
+static json_object * parseInput(enum json_tokener_error * parseError)
+{
+	json_object * obj = NULL;
+	struct json_tokener *tok = json_tokener_new();
+	if(! tok)
+		exit(EX_OSERR);
+	do
+	{
+		const char * chunk;
+		ssize_t readRc = nextInput(&chunk);
+		if(0 >= readRc)
+		{
+			*parseError = json_tokener_error_parse_eof;
+			break;
+		}
+		obj = json_tokener_parse_ex(tok, chunk, readRc);
+	}
+	while(json_tokener_continue == (*parseError = json_tokener_get_error(tok)));
+	json_tokener_free(tok);
+	return obj;
+}
+
+
+#ifndef JKPARSE_BUILTIN
+//  Parse the whole input, from inputText or stdin, and return the parsed value, or NULL with
+// *parseError set
+static jsonValue parseDocument(enum json_tokener_error * parseError)
+{
+#ifdef USE_TAPE_PARSER
+	//  Values to be edited with --set or --merge are always json-c objects
+	if(! options.editCount && ! options.mergeCount)
+	{
+		//  The text of an argument or a mapped file is followed by its NUL
+		ssize_t length = inputText ? (ssize_t)inputTextLength - 1 : readAllInput();
+		if(0 > length)
+		{
+			*parseError = json_tokener_error_parse_eof;
+			return JSON_C_VALUE(NULL);
+		}
+		jsonValue val = tapeParse(inputText, length);
+		if(val.entry)
+		{
+			*parseError = json_tokener_success;
+			return val;
+		}
+	}
+#endif
+	return JSON_C_VALUE(parseInput(parseError));
+}
+#endif
+
+
+//  Output the input escaped as a JSON string, up to its end or its first NUL character, as it is
+// read.  Return 0, or errno upon a read error.
+static int stringifyInput(void)
+{
+	const char * chunk;
+	ssize_t length;
+	if(options.quoteStrings)
+		putc_unlocked('"', output);
+	while(0 < (length = nextInput(&chunk)))
+	{
+		const char * nul = memchr(chunk, 0, length);
+		putJsonEscapedChars(chunk, nul ? nul - chunk : length);
+		if(nul)
+			break;
+	}
+	if(0 > length)
+	{
+		if(options.verbose)
+			fprintf(stderr, "Error reading input: %s\n", strerror(errno));
+		return errno;
+	}
+	if(options.quoteStrings)
+		putc_unlocked('"', output);
+	return EXIT_SUCCESS;
+}
+
+
+#ifndef JKPARSE_BUILTIN
+//  Parse JSON from a string in the same manner as json_tokener_parse_verbose(), but using tok
+static json_object * parseString(struct json_tokener * tok, const char * str,
+	enum json_tokener_error * parseError)
+{
+	json_tokener_reset(tok);
+	json_object * obj = json_tokener_parse_ex(tok, str, -1);
+	if(json_tokener_success != (*parseError = json_tokener_get_error(tok)))
+	{
+		json_object_put(obj);
+		obj = NULL;
+	}
+	return obj;
+}
+
+
+//  In multiple document mode, a series of JSON texts, such as newline delimited JSON, is parsed
+// with a single tokener that is reset for each document.  The output for each document is either
+// terminated by a NUL character, or declares variables whose names are suffixed with the number of
+// the document, counting from 1.  With the -j option, each JSON text is instead terminated by a
+// newline.  After a parse error, the input is skipped up to the next newline.
+
+//  Output the result of parsing the document numbered number, and return the exit code
+static int outputDocument(json_object * obj, enum json_tokener_error parseError, long number)
+{
+	int rc;
+	if(options.multipleNumbered && ! options.printJson)
+	{
+		char ** varNames[] = {&options.objVarName, &options.typeVarName, &options.arrayVarName};
+		char * unnumberedVarNames[] = {options.objVarName, options.typeVarName,
+			options.arrayVarName};
+		rc = EXIT_SUCCESS;
+		for(int var = 0; var < 3; var++)
+			if(*unnumberedVarNames[var] &&
+				0 > asprintf(varNames[var], "%s_%ld", unnumberedVarNames[var], number))
+			{
+				*varNames[var] = unnumberedVarNames[var];
+				rc = EX_OSERR;
+			}
+		if(! rc)
+			rc = outputResult(JSON_C_VALUE(obj), parseError);
+		for(int var = 0; var < 3; var++)
+			if(*varNames[var] != unnumberedVarNames[var])
+			{
+				free(*varNames[var]);
+				*varNames[var] = unnumberedVarNames[var];
+			}
+	}
+	else
+	{
+		rc = outputResult(JSON_C_VALUE(obj), parseError);
+		putc_unlocked(options.printJson ? '\n' : 0, output);
+	}
+	if(rc && options.verbose)
+		fprintf(stderr, "Error in document %ld\n", number);
+	return rc;
+}
+
+
+//  Parse and output each document in the input.  Return the exit code of the last document that
+// failed, or 0 if none did.
+static int multipleInput(void)
+{
+	struct json_tokener * tok = json_tokener_new();
+	if(! tok)
+		return EX_OSERR;
+	const char * pos = NULL;
+	const char * end = NULL;
+	int isEnd = 0;
+	int isParsing = 0;
+	int isSkipping = 0;
+	long number = 0;
+	int rc = EXIT_SUCCESS;
+	while(1)
+	{
+		if(pos == end)
+		{
+			if(isEnd)
+				break;
+			ssize_t readRc = nextInput(&pos);
+			if(0 > readRc)
+			{
+				if(options.verbose)
+					fprintf(stderr, "Error reading input: %s\n", strerror(errno));
+				rc = EX_IOERR;
+				break;
+			}
+			//  As for inputText, a NUL completes a final document, such as a number, that is not
+			// followed by whitespace
+			if((isEnd = ! readRc))
+				pos = "";
+			end = pos + (isEnd ? 1 : readRc);
+			continue;
+		}
+		if(isSkipping)
+		{
+			const char * newline = memchr(pos, '\n', end - pos);
+			isSkipping = ! newline;
+			pos = newline ? newline + 1 : end;
+			continue;
+		}
+		if(! isParsing)
+		{
+			//  NUL characters between documents are treated as whitespace
+			while(pos < end && (isspace((unsigned char)*pos) || ! *pos))
+				pos++;
+			if(pos == end)
+				continue;
+			json_tokener_reset(tok);
+			isParsing = 1;
+		}
+		json_object * obj = json_tokener_parse_ex(tok, pos, end - pos);
+		enum json_tokener_error parseError = json_tokener_get_error(tok);
+		if(json_tokener_continue == parseError)
+		{
+			pos = end;
+			if(! isEnd)
+				continue;
+			parseError = json_tokener_error_parse_eof;
+		}
+		else
+			pos += json_tokener_get_parse_end(tok);
+		isParsing = 0;
+		if(parseError)
+		{
+			json_object_put(obj);
+			obj = NULL;
+			isSkipping = 1;
+		}
+		int documentRc = outputDocument(obj, parseError, ++number);
+		json_object_put(obj);
+		if(documentRc)
+			rc = documentRc;
+	}
+	json_tokener_free(tok);
+	return rc;
+}
+#endif
+
+
+#ifndef JKPARSE_BUILTIN
+//  In stream mode, the members of a top level array or object are output as soon as each one is
+// parsed, and then freed, so that memory use is bound by the largest member rather than by the
+// whole document.  The structure of the container is scanned here, while its keys and member
+// values are parsed with a json-c tokener.  The member types are buffered, since the types array
+// variable is declared after the object variable.
+struct memberStream
+{
+	enum
+	{
+		STREAM_START,
+		STREAM_KEY_OR_END,
+		STREAM_KEY,
+		STREAM_COLON,
+		STREAM_VALUE_OR_END,
+		STREAM_VALUE,
+		STREAM_COMMA_OR_END,
+		STREAM_SCALAR,
+		STREAM_TRAILER,
+		STREAM_DONE
+	} state;
+	//  Progress through a comment between tokens, which json-c permits
+	enum
+	{
+		COMMENT_NONE,
+		COMMENT_START,
+		COMMENT_BLOCK,
+		COMMENT_BLOCK_END,
+		COMMENT_LINE
+	} commentState;
+	json_type containerType;
+	struct json_tokener * tok;
+	json_object * key;
+	json_object * scalar;
+	//  In raw mode, the text of the value being parsed, which may span chunks
+	char * raw;
+	size_t rawLength;
+	size_t rawCapacity;
+	int memberCount;
+	int isFirstMember;
+	FILE * typeStream;
+	char * types;
+	size_t typesLength;
+};
+
+
+//  Advance *pos past whitespace and comments.  Return 1 if a token, or the NUL character ending an
+// argument, was reached before end, 0 if not, or -1 upon an invalid comment.
+static int streamSkipWhitespace(struct memberStream * stream, const char ** pos, const char * end)
+{
+	for(; *pos < end; (*pos)++)
+	{
+		char c = **pos;
+		if(! c && COMMENT_NONE != stream->commentState && COMMENT_START != stream->commentState)
+		{
+			stream->commentState = COMMENT_NONE;
+			return 1;
+		}
+		switch(stream->commentState)
+		{
+		case COMMENT_NONE:
+			if('/' == c)
+				stream->commentState = COMMENT_START;
+			else if(' ' != c && '\t' != c && '\n' != c && '\r' != c)
+				return 1;
+			break;
+		case COMMENT_START:
+			if('*' == c)
+				stream->commentState = COMMENT_BLOCK;
+			else if('/' == c)
+				stream->commentState = COMMENT_LINE;
+			else
+				return -1;
+			break;
+		case COMMENT_BLOCK:
+			if('*' == c)
+				stream->commentState = COMMENT_BLOCK_END;
+			break;
+		case COMMENT_BLOCK_END:
+			if('/' == c)
+				stream->commentState = COMMENT_NONE;
+			else if('*' != c)
+				stream->commentState = COMMENT_BLOCK;
+			break;
+		case COMMENT_LINE:
+			if('\n' == c)
+				stream->commentState = COMMENT_NONE;
+			break;
+		}
+	}
+	return 0;
+}
+
+
+//  Continue parsing a key, member value, or top level scalar with the stream's tokener.  Return
+// json_tokener_continue if more input is needed, otherwise the tokener's result, with *parsed set
+// to the parsed object and *pos advanced past it upon success.
+static enum json_tokener_error streamParseValue(struct memberStream * stream, const char ** pos,
+	const char * end, json_object ** parsed)
+{
+	*parsed = json_tokener_parse_ex(stream->tok, *pos, end - *pos);
+	enum json_tokener_error parseError = json_tokener_get_error(stream->tok);
+	if(json_tokener_continue == parseError)
+		*pos = end;
+	else
+	{
+		*pos += json_tokener_get_parse_end(stream->tok);
+		json_tokener_reset(stream->tok);
+	}
+	return parseError;
+}
+
+
+//  Return pos advanced past any whitespace and comments in NUL terminated text
+static const char * skipJsonWhitespace(const char * pos)
+{
+	while(1)
+	{
+		if(' ' == *pos || '\t' == *pos || '\n' == *pos || '\r' == *pos)
+			pos++;
+		else if('/' == *pos && '*' == pos[1])
+		{
+			const char * commentEnd = strstr(pos + 2, "*/");
+			pos = commentEnd ? commentEnd + 2 : pos + strlen(pos);
+		}
+		else if('/' == *pos && '/' == pos[1])
+			pos += strcspn(pos, "\n");
+		else
+			return pos;
+	}
+}
+
+
+//  Return pos advanced past the JSON value that it points to in NUL terminated text, which json-c
+// has already parsed successfully
+static const char * skipJsonValue(const char * pos)
+{
+	int depth = 0;
+	do
+	{
+		switch(*pos)
+		{
+		case '"':
+		case '\'':
+			{
+				char quote = *pos++;
+				while(*pos && quote != *pos)
+					pos += '\\' == *pos && pos[1] ? 2 : 1;
+				if(*pos)
+					pos++;
+			}
+			break;
+		case '[':
+		case '{':
+			depth++;
+			pos++;
+			break;
+		case ']':
+		case '}':
+			depth--;
+			pos++;
+			break;
+		case '/':
+			pos = skipJsonWhitespace(pos);
+			break;
+		default:
+			pos = depth ? pos + 1 : pos + strcspn(pos, " \t\n\r,]}/");
+		}
+	}
+	while(0 < depth && *pos);
+	return pos;
+}
+
+
+//  In raw mode, append the text from start to end to the raw text of the value being parsed
+static enum json_tokener_error streamAppendRaw(struct memberStream * stream, const char * start,
+	const char * end)
+{
+	if(stream->rawLength + (end - start) >= stream->rawCapacity)
+	{
+		stream->rawCapacity = (stream->rawLength + (end - start)) * 2 + 64;
+		if(! (stream->raw = realloc(stream->raw, stream->rawCapacity)))
+			return json_tokener_error_memory;
+	}
+	memcpy(stream->raw + stream->rawLength, start, end - start);
+	stream->rawLength += end - start;
+	stream->raw[stream->rawLength] = '\0';
+	return json_tokener_success;
+}
+
+
+//  In raw mode, have val serialize as its text in the input, without the surrounding whitespace and
+// comments, rather than be serialized by json-c.  Strings, whose values are output rather than
+// their JSON text, booleans, and null are left as they are.
+static void streamUseRaw(struct memberStream * stream, json_object * val)
+{
+	json_type type = json_object_get_type(val);
+	if(json_type_array == type || json_type_object == type || json_type_int == type ||
+		json_type_double == type)
+	{
+		char * rawStart = (char *)skipJsonWhitespace(stream->raw);
+		*(char *)skipJsonValue(rawStart) = '\0';
+		json_object_set_serializer(val, json_object_userdata_to_json_string, rawStart, NULL);
+	}
+	stream->rawLength = 0;
+}
+
+
+//  Output a parsed member, and buffer its type
+static void streamOutputMember(struct memberStream * stream, json_object * parsed)
+{
+	FILE * valueOutput = output;
+	const char * valueVarName = memberVarName;
+	enum statsPhase previousPhase = STATS_PHASE(STATS_OUTPUT);
+	jsonValue val = JSON_C_VALUE(parsed);
+	void (*valPrint)(jsonValue) = options.quoteStrings ? valPrintWithQuotedStrings :
+		valPrintWithoutQuotedStrings;
+	void (*typePrint)(jsonValue) = options.quoteStrings ? valTypePrintWithQForStrings :
+		valTypePrint;
+	//  Negative --range bounds are not streamed, so the bounds do not depend on the length
+	size_t rangeStart = options.range ? rangeBound(options.rangeStart, LONG_MAX) : 0;
+	if(json_type_object == stream->containerType ?
+		! isKeySelected(json_object_get_string(stream->key)) : options.range &&
+		((size_t)stream->memberCount < rangeStart ||
+			(size_t)stream->memberCount >= rangeBound(options.rangeEnd, LONG_MAX)))
+	{
+		//  The member is excluded by --select or --range, so it is parsed but not output
+	}
+	else if(options.flatten)
+	{
+		int isFirstTypeMember = stream->isFirstMember;
+		size_t keyLength = json_type_object == stream->containerType ?
+			appendKeyToFlattenedKey(0, json_object_get_string(stream->key), 1) :
+			appendIndexToFlattenedKey(0, stream->memberCount);
+		printFlattenedMember(val, keyLength, valPrint, &stream->isFirstMember);
+		if(stream->typeStream)
+		{
+			output = stream->typeStream;
+			memberVarName = lastWord(options.arrayVarName);
+			printFlattenedMember(val, keyLength, typePrint, &isFirstTypeMember);
+		}
+	}
+	else if(json_type_object == stream->containerType)
+	{
+		const char * key = json_object_get_string(stream->key);
+		if(printObjectMember(key, val, valPrint, stream->isFirstMember))
+		{
+			if(stream->typeStream)
+			{
+				output = stream->typeStream;
+				memberVarName = lastWord(options.arrayVarName);
+				printObjectMember(key, val, typePrint, stream->isFirstMember);
+			}
+			stream->isFirstMember = 0;
+		}
+	}
+	else
+	{
+		putArrayMemberStart(stream->memberCount - rangeStart);
+		(options.quoteStrings ? valPrintWithQuotedStrings : arrayValPrintWithoutQuotedStrings)(val);
+		if(stream->typeStream)
+		{
+			output = stream->typeStream;
+			memberVarName = lastWord(options.arrayVarName);
+			putArrayMemberStart(stream->memberCount - rangeStart);
+			typePrint(val);
+		}
+		stream->isFirstMember = 0;
+	}
+	output = valueOutput;
+	memberVarName = valueVarName;
+	json_object_put(stream->key);
+	stream->key = NULL;
+	stream->memberCount++;
+	json_object_put(parsed);
+	STATS_SET_PHASE(previousPhase);
+}
+
+
+//  Process a chunk of input in stream mode.  Return json_tokener_continue if more input is
+// needed, json_tokener_success once the top level value is complete, or the parse error.
+static enum json_tokener_error streamChunk(struct memberStream * stream, const char * chunk,
+	size_t length)
+{
+	const char * pos = chunk;
+	const char * end = chunk + length;
+	const char * valueStart;
+	enum json_tokener_error parseError;
+	json_object * parsed;
+	while(STREAM_DONE != stream->state)
+	{
+		if(STREAM_KEY != stream->state && STREAM_VALUE != stream->state &&
+			STREAM_SCALAR != stream->state)
+		{
+			int tokenReached = streamSkipWhitespace(stream, &pos, end);
+			if(! tokenReached)
+				return json_tokener_continue;
+			if(0 > tokenReached)
+				return json_tokener_error_parse_comment;
+			if(! *pos && STREAM_START != stream->state && STREAM_TRAILER != stream->state)
+				return json_tokener_error_parse_eof;
+		}
+		switch(stream->state)
+		{
+		case STREAM_START:
+			if('[' == *pos || '{' == *pos)
+			{
+				if('[' == *pos)
+				{
+					stream->containerType = json_type_array;
+					stream->state = STREAM_VALUE_OR_END;
+					printTypeAndBeginObjWithType('a', options.flatten ? associativeDeclareType :
+						arrayDeclareType);
+				}
+				else
+				{
+					stream->containerType = json_type_object;
+					stream->state = STREAM_KEY_OR_END;
+					printTypeAndBeginObjWithType('o', associativeDeclareType);
+				}
+				beginVarMembers(options.objVarName);
+				pos++;
+				if(*options.arrayVarName && ! (stream->typeStream =
+					open_memstream(&stream->types, &stream->typesLength)))
+					return json_tokener_error_memory;
+			}
+			else
+				stream->state = STREAM_SCALAR;
+			break;
+		case STREAM_KEY_OR_END:
+			if('}' == *pos)
+			{
+				pos++;
+				stream->state = STREAM_TRAILER;
+			}
+			else if('"' != *pos && '\'' != *pos)
+				return json_tokener_error_parse_object_key_name;
+			else
+				stream->state = STREAM_KEY;
+			break;
+		case STREAM_KEY:
+			parseError = streamParseValue(stream, &pos, end, &parsed);
+			if(json_tokener_continue == parseError)
+				return parseError;
+			if(parseError)
+				return parseError;
+			if(json_type_string != json_object_get_type(parsed))
+			{
+				json_object_put(parsed);
+				return json_tokener_error_parse_object_key_name;
+			}
+			stream->key = parsed;
+			stream->state = STREAM_COLON;
+			break;
+		case STREAM_COLON:
+			if(':' != *pos)
+				return json_tokener_error_parse_object_key_sep;
+			pos++;
+			stream->state = STREAM_VALUE;
+			break;
+		case STREAM_VALUE_OR_END:
+			if(']' == *pos)
+			{
+				pos++;
+				stream->state = STREAM_TRAILER;
+			}
+			else
+				stream->state = STREAM_VALUE;
+			break;
+		case STREAM_VALUE:
+			valueStart = pos;
+			parseError = streamParseValue(stream, &pos, end, &parsed);
+			if(options.raw && ! options.flatten && (json_tokener_success == parseError ||
+				json_tokener_continue == parseError) && streamAppendRaw(stream, valueStart, pos))
+				parseError = json_tokener_error_memory;
+			if(parseError)
+			{
+				json_object_put(parsed);
+				return parseError;
+			}
+			if(options.raw && ! options.flatten)
+				streamUseRaw(stream, parsed);
+			streamOutputMember(stream, parsed);
+			stream->state = STREAM_COMMA_OR_END;
+			break;
+		case STREAM_COMMA_OR_END:
+			if(',' == *pos)
+				stream->state = json_type_object == stream->containerType ?
+					STREAM_KEY_OR_END : STREAM_VALUE_OR_END;
+			else if((json_type_object == stream->containerType ? '}' : ']') == *pos)
+				stream->state = STREAM_TRAILER;
+			else
+				return json_type_object == stream->containerType ?
+					json_tokener_error_parse_object_value_sep : json_tokener_error_parse_array;
+			pos++;
+			break;
+		case STREAM_SCALAR:
+			valueStart = pos;
+			parseError = streamParseValue(stream, &pos, end, &parsed);
+			if(options.raw && (json_tokener_success == parseError ||
+				json_tokener_continue == parseError) && streamAppendRaw(stream, valueStart, pos))
+				parseError = json_tokener_error_memory;
+			if(parseError)
+			{
+				json_object_put(parsed);
+				return parseError;
+			}
+			if(options.raw)
+				streamUseRaw(stream, parsed);
+			stream->scalar = parsed;
+			stream->state = STREAM_DONE;
+			break;
+		case STREAM_TRAILER:
+			//  As json-c does, ignore anything following the value other than whitespace and
+			// comments
+			stream->state = STREAM_DONE;
+			break;
+		case STREAM_DONE:
+			break;
+		}
+	}
+	return json_tokener_success;
+}
+
+
+//  Return non-zero if the options in effect call for stream mode
+static int isStreamed(void)
+{
+	return (options.stream || options.raw) && *options.objVarName && ! options.pathLength &&
+		! options.printJson && ! options.editCount && ! options.mergeCount && ! options.tree &&
+		FORMAT_SHELL == options.format &&
+		! (options.range &&
+		((LONG_MIN != options.rangeStart && 0 > options.rangeStart) || 0 > options.rangeEnd));
+}
+
+
+//  Parse and output the input in stream mode, from arg if it is not NULL, otherwise from stdin,
+// and return the exit code
+static int streamInput(void)
+{
+	struct memberStream stream = {.state = STREAM_START, .containerType = json_type_null,
+		.isFirstMember = 1};
+	enum json_tokener_error parseError;
+	if(! (stream.tok = json_tokener_new()))
+		return EX_OSERR;
+	const char * chunk;
+	ssize_t readRc;
+	do
+	{
+		if(0 >= (readRc = nextInput(&chunk)))
+		{
+			parseError = STREAM_TRAILER == stream.state && COMMENT_NONE == stream.commentState ?
+				json_tokener_success : json_tokener_error_parse_eof;
+			break;
+		}
+	}
+	while(json_tokener_continue == (parseError = streamChunk(&stream, chunk, readRc)));
+	json_tokener_free(stream.tok);
+	json_object_put(stream.key);
+	if(json_type_null == stream.containerType)
+	{
+		int rc = outputResult(JSON_C_VALUE(stream.scalar), parseError);
+		json_object_put(stream.scalar);
+		free(stream.raw);
+		return rc;
+	}
+	free(stream.raw);
+	//  Close the container's declaration, with any buffered types
+	if(stream.typeStream)
+	{
+		fclose(stream.typeStream);
+		printArrayClosureAndBeginArrayVar(json_type_object == stream.containerType ||
+			options.flatten ? associativeDeclareType : arrayDeclareType);
+		fwrite_unlocked(stream.types, stream.typesLength, 1, output);
+		free(stream.types);
+	}
+	endVarMembers();
+	putc_unlocked('\n', output);
+	if(parseError)
+	{
+		//  The object variable has already been declared, so declare it again as null
+		if(options.verbose)
+			fprintf(stderr, "Error parsing JSON: %s\n", json_tokener_error_desc(parseError));
+		options.unsetVars = 1;
+		//  The member types declared with it describe members that a null value does not have
+		if(*options.arrayVarName)
+			fprintf(output, "unset %s;", options.arrayVarName);
+		printDeclarations(JSON_C_VALUE(NULL), parseError);
+	}
+	return parseError;
+}
+#endif
+
+
+//  Values for long options without a short equivalent
+//  With --encode, the input is shell code declaring variables, as output by typeset -p in bash,
+// ksh93, or zsh, and the array or object in the JSON_OBJ variable is output as JSON, using the
+// types in the JSON_OBJ_TYPES variable, or as JSON text if that is not given, as with -q.  This is
+// the reverse of the usual operation.  Only the subset of shell syntax used by typeset -p is
+// parsed: declaration commands and assignments, with quoted and unquoted words.
+struct shellElement
+{
+	//  key is NULL for an element of an indexed array, which is at index
+	char * key;
+	long index;
+	char * value;
+	//  The order of the element's assignment
+	int position;
+};
+
+struct shellVar
+{
+	const char * name;
+	//  'A' for an associative array, 'a' for an indexed array, or 0 for a scalar
+	char declareType;
+	int isSet;
+	int elementCount;
+	int elementCapacity;
+	struct shellElement * elements;
+	char * value;
+};
+
+
+//  Parse the shell word at *in, advancing *in past it, and copy its value to *out, advancing *out
+// past its terminating NUL character.  Within a subscript, the word is terminated only by an
+// unquoted ']'.  Otherwise, it is terminated by unquoted whitespace, ';', '(', or ')'.  Return the
+// start of the copied value, or NULL upon an unterminated quotation.
+static char * parseShellWord(const char ** in, char ** out, int isSubscript)
+{
+	static const char ansiCChars[] = "abeEfnrtv";
+	static const char ansiCValues[] = "\a\b\033\033\f\n\r\t\v";
+	const char * pos = *in;
+	char * word = *out;
+	char * wordPos = word;
+	while(*pos)
+	{
+		if(isSubscript ? ']' == *pos : NULL != strchr(" \t\n;()", *pos))
+			break;
+		if('\'' == *pos)
+		{
+			const char * end = strchr(++pos, '\'');
+			if(! end)
+				return NULL;
+			memcpy(wordPos, pos, end - pos);
+			wordPos += end - pos;
+			pos = end + 1;
+		}
+		else if('$' == pos[0] && '\'' == pos[1])
+		{
+			for(pos += 2; '\'' != *pos; pos++)
+			{
+				const char * escapeChar;
+				if(! *pos)
+					return NULL;
+				if('\\' != *pos)
+					*(wordPos++) = *pos;
+				else if(! *(++pos))
+					return NULL;
+				else if((escapeChar = strchr(ansiCChars, *pos)))
+					*(wordPos++) = ansiCValues[escapeChar - ansiCChars];
+				else if('0' <= *pos && '7' >= *pos)
+				{
+					unsigned char c = 0;
+					for(int digit = 0; 3 > digit && '0' <= *pos && '7' >= *pos; digit++)
+						c = (c << 3) | (*(pos++) - '0');
+					*(wordPos++) = c;
+					pos--;
+				}
+				else if(('x' == *pos || 'u' == *pos || 'U' == *pos) && isxdigit((unsigned char)pos[1]))
+				{
+					int maxDigits = 'x' == *pos ? 2 : 'u' == *pos ? 4 : 8;
+					int isByte = 'x' == *pos;
+					unsigned long value = 0;
+					for(int digit = 0; maxDigits > digit && isxdigit((unsigned char)pos[1]); digit++)
+					{
+						pos++;
+						value = (value << 4) | (isdigit((unsigned char)*pos) ? *pos - '0' :
+							(*pos | 0x20) - 'a' + 10);
+					}
+					if(isByte)
+						*(wordPos++) = value;
+					else
+						putUtf8(&wordPos, value);
+				}
+				else if('c' == *pos && pos[1])
+					*(wordPos++) = *(++pos) & 0x1f;
+				else if(strchr("\\'\"?", *pos))
+					*(wordPos++) = *pos;
+				else
+				{
+					*(wordPos++) = '\\';
+					*(wordPos++) = *pos;
+				}
+			}
+			pos++;
+		}
+		else if('"' == *pos || ('$' == pos[0] && '"' == pos[1]))
+		{
+			for(pos += '$' == *pos ? 2 : 1; '"' != *pos; pos++)
+			{
+				if(! *pos)
+					return NULL;
+				if('\\' == *pos && strchr("$`\"\\\n", pos[1]) && pos[1])
+				{
+					if('\n' == *(++pos))
+						continue;
+				}
+				*(wordPos++) = *pos;
+			}
+			pos++;
+		}
+		else if('\\' == *pos)
+		{
+			if(! *(++pos))
+				break;
+			if('\n' != *pos)
+				*(wordPos++) = *pos;
+			pos++;
+		}
+		else
+			*(wordPos++) = *(pos++);
+	}
+	*(wordPos++) = '\0';
+	*in = pos;
+	*out = wordPos;
+	return word;
+}
+
+
+//  Advance *in past blanks, and also newlines and comments if withNewlines is non-zero
+static void skipShellBlanks(const char ** in, int withNewlines)
+{
+	while(1)
+	{
+		if(' ' == **in || '\t' == **in || (withNewlines && '\n' == **in))
+			(*in)++;
+		else if('\\' == **in && '\n' == (*in)[1])
+			*in += 2;
+		else if(withNewlines && '#' == **in)
+			*in += strcspn(*in, "\n");
+		else
+			break;
+	}
+}
+
+
+//  Add an element to var, if it is not NULL
+static void addShellElement(struct shellVar * var, char * key, long index, char * value)
+{
+	if(! var)
+		return;
+	if(var->elementCount >= var->elementCapacity)
+	{
+		var->elementCapacity = var->elementCapacity ? var->elementCapacity * 2 : 16;
+		if(! (var->elements = realloc(var->elements, var->elementCapacity * sizeof(*var->elements))))
+			exit(EX_OSERR);
+	}
+	var->elements[var->elementCount] = (struct shellElement){key, index, value, var->elementCount};
+	var->elementCount++;
+}
+
+
+//  Parse the value of an assignment to var, which is NULL if the variable is not of interest, at
+// *in.  Return non-zero upon a syntax error.
+static int parseShellAssignment(const char ** in, char ** out, struct shellVar * var)
+{
+	if(var)
+	{
+		var->isSet = 1;
+		var->elementCount = 0;
+	}
+	if('(' != **in)
+	{
+		char * value = parseShellWord(in, out, 0);
+		if(var)
+			var->value = value;
+		return ! value;
+	}
+	if(var && ! var->declareType)
+		var->declareType = 'a';
+	long index = -1;
+	char * pendingKey = NULL;
+	for((*in)++; ; )
+	{
+		skipShellBlanks(in, 1);
+		if(! **in)
+			return 1;
+		if(')' == **in)
+		{
+			(*in)++;
+			break;
+		}
+		char * key = NULL;
+		if('[' == **in)
+		{
+			(*in)++;
+			if(! (key = parseShellWord(in, out, 1)) || ']' != **in || '=' != (*in)[1])
+				return 1;
+			*in += 2;
+		}
+		char * value = parseShellWord(in, out, 0);
+		if(! value || (! key && ! *value && ! strchr(" \t\n)", **in)))
+			return 1;
+		if(var && 'A' == var->declareType)
+		{
+			//  zsh formerly listed associative arrays as alternating keys and values
+			if(key)
+				addShellElement(var, key, 0, value);
+			else if(pendingKey)
+			{
+				addShellElement(var, pendingKey, 0, value);
+				pendingKey = NULL;
+			}
+			else
+				pendingKey = value;
+		}
+		else
+		{
+			index = key ? strtol(key, NULL, 10) : index + 1;
+			addShellElement(var, NULL, index, value);
+		}
+	}
+	return 0;
+}
+
+
+//  Parse the declarations in input, and fill in the vars that are named in them, with the parsed
+// words copied to out.  Return non-zero upon a syntax error.
+static int parseShellDeclarations(const char * input, char * out, struct shellVar * vars,
+	int varCount)
+{
+	static const char * const declareCommands[] = {"declare", "typeset", "local", "export",
+		"readonly", NULL};
+	while(1)
+	{
+		skipShellBlanks(&input, 1);
+		if(';' == *input)
+		{
+			input++;
+			continue;
+		}
+		if(! *input)
+			return 0;
+		size_t nameLength = strspn(input, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+			"0123456789_");
+		int isDeclaration = 0;
+		for(const char * const * command = declareCommands; *command; command++)
+		{
+			if(strlen(*command) == nameLength && ! strncmp(*command, input, nameLength))
+				isDeclaration = 1;
+		}
+		char declareType = 0;
+		if(isDeclaration)
+		{
+			input += nameLength;
+			skipShellBlanks(&input, 0);
+			while('-' == *input || '+' == *input)
+			{
+				char * flags = parseShellWord(&input, &out, 0);
+				if(! flags)
+					return 1;
+				if('-' == *flags && (strchr(flags, 'A') || strchr(flags, 'a')))
+					declareType = strchr(flags, 'A') ? 'A' : 'a';
+				skipShellBlanks(&input, 0);
+				if(! strcmp(flags, "--"))
+					break;
+			}
+			nameLength = strspn(input, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+				"0123456789_");
+		}
+		//  Process each name, with any assignment, until the end of the command
+		while(nameLength)
+		{
+			struct shellVar * var = NULL;
+			for(int varIndex = 0; varIndex < varCount; varIndex++)
+			{
+				if(strlen(vars[varIndex].name) == nameLength &&
+					! strncmp(vars[varIndex].name, input, nameLength))
+					var = vars + varIndex;
+			}
+			input += nameLength;
+			if(var && isDeclaration)
+			{
+				var->declareType = declareType;
+				var->isSet = 1;
+				var->elementCount = 0;
+				var->value = NULL;
+			}
+			if('=' == *input)
+			{
+				input++;
+				if(parseShellAssignment(&input, &out, var))
+					return 1;
+			}
+			if(! isDeclaration)
+				break;
+			skipShellBlanks(&input, 0);
+			nameLength = strspn(input, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+				"0123456789_");
+		}
+		//  Skip anything else until the end of the command
+		while(*input && '\n' != *input && ';' != *input)
+		{
+			skipShellBlanks(&input, 0);
+			if(*input && '\n' != *input && ';' != *input && ! parseShellWord(&input, &out, 0))
+				return 1;
+			if('(' == *input || ')' == *input)
+				input++;
+		}
+	}
+}
+
+
+//  Output value as JSON according to its type character, where value is NULL for a missing array
+// element.  Values of types other than strings and null are output verbatim, as JSON text.
+static void putEncodedValue(const char * value, char type)
+{
+	if('s' == type && value)
+		putJsonEscapedString(value, 1);
+	else if('n' == type || ! value || ! *value)
+		fputs_unlocked("null", output);
+	else
+		fputs_unlocked(value, output);
+}
+
+
+//  Order array elements by index, and then by the order of assignment
+static int compareShellElements(const void * a, const void * b)
+{
+	const struct shellElement * elementA = a;
+	const struct shellElement * elementB = b;
+	if(elementA->index != elementB->index)
+		return elementA->index < elementB->index ? -1 : 1;
+	return elementA->position - elementB->position;
+}
+
+
+//  Sort the elements of an indexed array, keeping only the last of any with the same index
+static void sortShellElements(struct shellVar * var)
+{
+	int isSorted = 1;
+	for(int element = 1; element < var->elementCount && isSorted; element++)
+		isSorted = var->elements[element - 1].index < var->elements[element].index;
+	if(isSorted)
+		return;
+	qsort(var->elements, var->elementCount, sizeof(*var->elements), compareShellElements);
+	int keptCount = 0;
+	for(int element = 0; element < var->elementCount; element++)
+	{
+		if(keptCount && var->elements[keptCount - 1].index == var->elements[element].index)
+			keptCount--;
+		var->elements[keptCount++] = var->elements[element];
+	}
+	var->elementCount = keptCount;
+}
+
+
+//  Output the array or object described by the shell variable declarations in input as JSON, and
+// return the exit code
+static int encodeShellVariables(const char * input)
+{
+	struct shellVar vars[3] = {{.name = lastWord(options.objVarName)},
+		{.name = lastWord(options.arrayVarName)}, {.name = lastWord(options.typeVarName)}};
+	struct shellVar * valueVar = vars;
+	struct shellVar * typesVar = *vars[1].name ? vars + 1 : NULL;
+	struct shellVar * typeVar = *vars[2].name ? vars + 2 : NULL;
+	int rc = EXIT_SUCCESS;
+	//  The parsed words are no longer than the input, apart from a terminating NUL character each,
+	// and EMPTY_KEY is shell code that is parsed likewise
+	char * words = malloc(strlen(input) * 2 + 2);
+	char * emptyKey = malloc(strlen(options.emptyKey) * 2 + 2);
+	if(! words || ! emptyKey)
+		return EX_OSERR;
+	char * emptyKeyOut = emptyKey;
+	const char * emptyKeyIn = options.emptyKey;
+	if(parseShellDeclarations(input, words, vars, 3) ||
+		! parseShellWord(&emptyKeyIn, &emptyKeyOut, 1))
+	{
+		if(options.verbose)
+			fputs("Error parsing shell declarations\n", stderr);
+		rc = EX_DATAERR;
+	}
+	else if(! valueVar->isSet)
+	{
+		if(options.verbose)
+			fprintf(stderr, "No declaration of %s\n", valueVar->name);
+		rc = EX_DATAERR;
+	}
+	//  Types are matched to members by key or by index, so they can only be taken from an array
+	// of the same kind
+	else if(valueVar->declareType && typesVar && typesVar->isSet &&
+		typesVar->declareType != valueVar->declareType)
+	{
+		if(options.verbose)
+			fprintf(stderr, "%s is not declared as the same kind of array as %s\n", typesVar->name,
+				valueVar->name);
+		rc = EX_DATAERR;
+	}
+	else if('A' == valueVar->declareType)
+	{
+		json_object * typesByKey = NULL;
+		if(typesVar && typesVar->elementCount)
+		{
+			typesByKey = json_object_new_object();
+			for(int element = 0; element < typesVar->elementCount; element++)
+				json_object_object_add(typesByKey, typesVar->elements[element].key,
+					json_object_new_string(typesVar->elements[element].value));
+		}
+		putc_unlocked('{', output);
+		for(int element = 0; element < valueVar->elementCount; element++)
+		{
+			const char * key = valueVar->elements[element].key;
+			json_object * type = NULL;
+			if(element)
+				putc_unlocked(',', output);
+			putJsonEscapedString(strcmp(key, emptyKey) ? key : "", 1);
+			putc_unlocked(':', output);
+			if(typesByKey)
+				json_object_object_get_ex(typesByKey, key, &type);
+			putEncodedValue(valueVar->elements[element].value,
+				type ? *json_object_get_string(type) : 0);
+		}
+		putc_unlocked('}', output);
+		json_object_put(typesByKey);
+	}
+	else if('a' == valueVar->declareType)
+	{
+		sortShellElements(valueVar);
+		if(typesVar)
+			sortShellElements(typesVar);
+		//  Missing elements of sparse arrays are output as null, unless compact, in which case
+		// they are skipped
+		long nextIndex = 0;
+		int typeElement = 0;
+		putc_unlocked('[', output);
+		for(int element = 0; element < valueVar->elementCount; element++)
+		{
+			long index = valueVar->elements[element].index;
+			if(0 > index)
+				continue;
+			for(; nextIndex < index && ! options.encodeCompact; nextIndex++)
+				fputs_unlocked(nextIndex ? ",null" : "null", output);
+			if(nextIndex)
+				putc_unlocked(',', output);
+			nextIndex = index + 1;
+			while(typesVar && typeElement < typesVar->elementCount &&
+				typesVar->elements[typeElement].index < index)
+				typeElement++;
+			putEncodedValue(valueVar->elements[element].value, typesVar &&
+				typeElement < typesVar->elementCount && typesVar->elements[typeElement].index == index ?
+				*typesVar->elements[typeElement].value : 0);
+		}
+		putc_unlocked(']', output);
+	}
+	else
+		putEncodedValue(valueVar->value ? valueVar->value : "", typeVar && typeVar->value ?
+			*typeVar->value : 0);
+	for(int var = 0; var < 3; var++)
+		free(vars[var].elements);
+	free(words);
+	free(emptyKey);
+	return rc;
+}
+
+
+#define OPTION_SERVER 0x100
+#define OPTION_FLATTEN_ESCAPE 0x101
+#define OPTION_FLATTEN_SEPARATOR 0x102
+#define OPTION_SET 0x103
+#define OPTION_ENCODE 0x104
+#define OPTION_FILE 0x105
+#define OPTION_STATS 0x106
+#define OPTION_SHELL 0x107
+#define OPTION_RANGE 0x108
+#define OPTION_SELECT 0x109
+#define OPTION_CACHE_DIR 0x10B
+#define OPTION_CACHE_SIZE 0x10C
+#define OPTION_FORMAT 0x10D
+#define OPTION_MERGE 0x10E
+#define OPTION_TREE 0x10F
+
+static const struct option longopts[] = {
+	// {.name, .has_arg, .flag, .val}
+	{"help", no_argument, NULL, '!'},
+	{"array-var", required_argument, NULL, 'a'},
+	{"cache-dir", required_argument, NULL, OPTION_CACHE_DIR},
+	{"cache-size", required_argument, NULL, OPTION_CACHE_SIZE},
+	{"index-base", required_argument, NULL, 'b'},
+	{"empty-key", required_argument, NULL, 'e'},
+	{"encode", optional_argument, NULL, OPTION_ENCODE},
+	{"file", required_argument, NULL, OPTION_FILE},
+	{"flatten", no_argument, NULL, 'f'},
+	{"flatten-escape", required_argument, NULL, OPTION_FLATTEN_ESCAPE},
+	{"flatten-separator", required_argument, NULL, OPTION_FLATTEN_SEPARATOR},
+	{"format", required_argument, NULL, OPTION_FORMAT},
+	{"local-declarations", no_argument, NULL, 'l'},
+	{"merge", required_argument, NULL, OPTION_MERGE},
+	{"multiple", optional_argument, NULL, 'm'},
+	{"obj-var", required_argument, NULL, 'o'},
+	{"path", required_argument, NULL, 'p'},
+	{"print-json", no_argument, NULL, 'j'},
+	{"quote-strings", no_argument, NULL, 'q'},
+	{"range", required_argument, NULL, OPTION_RANGE},
+	{"raw", no_argument, NULL, 'r'},
+	{"select", required_argument, NULL, OPTION_SELECT},
+	{"server", optional_argument, NULL, OPTION_SERVER},
+	{"set", required_argument, NULL, OPTION_SET},
+	{"shell", required_argument, NULL, OPTION_SHELL},
+	{"short-version", no_argument, NULL, 'v'},
+	{"stats", optional_argument, NULL, OPTION_STATS},
+	{"stream", no_argument, NULL, 'S'},
+	{"stringify", no_argument, NULL, 's'},
+	{"tree", no_argument, NULL, OPTION_TREE},
+	{"type-var", required_argument, NULL, 't'},
+	{"unset-vars", no_argument, NULL, 'u'},
+	{"verbose", no_argument, NULL, 'V'},
+	{"version", no_argument, NULL, '@'},
+	{0, 0, 0, 0}
+};
+static const char shortopts[] = "a:b:e:fjlmo:p:qrSst:uvV";
+
+
+//  Return non-zero if arg is an option whose argument is the next element of argv.  Abbreviated
+// long options are matched in the same manner as getopt_long().
+static int optionTakesNextArgument(const char * arg)
+{
+	if('-' != *arg || ! arg[1])
+		return 0;
+	if('-' == arg[1])
+	{
+		const char * name = arg + 2;
+		size_t nameLength = strlen(name);
+		const struct option * match = NULL;
+		int matchCount = 0;
+		if(! nameLength || strchr(name, '='))
+			return 0;
+		for(const struct option * longopt = longopts; longopt->name; longopt++)
+		{
+			if(strncmp(longopt->name, name, nameLength))
+				continue;
+			if(! longopt->name[nameLength])
+				return required_argument == longopt->has_arg;
+			match = longopt;
+			matchCount++;
+		}
+		//  An ambiguous abbreviation is an error that getopt_long() will report
+		return 1 == matchCount && required_argument == match->has_arg;
+	}
+	for(const char * shortopt = arg + 1; *shortopt; shortopt++)
+	{
+		const char * spec = strchr(shortopts, *shortopt);
+		if(spec && ':' == spec[1])
+			return ! shortopt[1];
+	}
+	return 0;
+}
+
+
+//  Return the index of the first "--group" argument of argv from start, other than an option's
+// argument or one following "--", or argc if there is none
+static int nextGroup(int argc, char ** argv, int start)
+{
+	int isOption = 1;
+	for(int arg = start; arg < argc; arg++)
+	{
+		if(! strcmp(argv[arg], "--group"))
+			return arg;
+		if(isOption && ! strcmp(argv[arg], "--"))
+			isOption = 0;
+		else if(isOption)
+			arg += optionTakesNextArgument(argv[arg]);
+	}
+	return argc;
+}
+
+
+//  Where options are parsed from, which determines the options that are not permitted
+enum optionsSource
+{
+	OPTIONS_COMMAND_LINE,
+	OPTIONS_SERVER_REQUEST,
+	OPTIONS_GROUP
+};
+
+//  Apply the options in argv.  Return -1 if processing should continue, otherwise the exit code.
+static int parseOptions(int argc, char **argv, enum optionsSource source)
+{
+	int currentoption;
+	opterr = 0;
+	//  Reinitialize getopt, which is necessary for the requests in server mode
+	optind = 0;
+	while( -1 != (currentoption = getopt_long(argc, argv, shortopts, longopts, &currentoption)) )
+	{
+		if(OPTIONS_SERVER_REQUEST == source && ('!' == currentoption || '@' == currentoption ||
+			'm' == currentoption || 's' == currentoption || 'v' == currentoption ||
+			OPTION_CACHE_DIR == currentoption || OPTION_CACHE_SIZE == currentoption ||
+			OPTION_FILE == currentoption || OPTION_FORMAT == currentoption ||
+			OPTION_MERGE == currentoption || OPTION_SERVER == currentoption ||
+			OPTION_STATS == currentoption))
+		{
+			fputs("Option not permitted in a server request\n", stderr);
+			return EX_USAGE;
+		}
+		if(OPTIONS_GROUP == source && ('!' == currentoption || '@' == currentoption ||
+			'j' == currentoption || 'm' == currentoption || 's' == currentoption ||
+			'v' == currentoption || OPTION_CACHE_DIR == currentoption ||
+			OPTION_CACHE_SIZE == currentoption || OPTION_ENCODE == currentoption ||
+			OPTION_FORMAT == currentoption || OPTION_MERGE == currentoption ||
+			OPTION_SERVER == currentoption || OPTION_SET == currentoption ||
+			OPTION_STATS == currentoption))
+		{
+			fputs("Option not permitted in a group\n", stderr);
+			return EX_USAGE;
+		}
+	#ifdef JKPARSE_BUILTIN
+		if('m' == currentoption || 'r' == currentoption || OPTION_CACHE_DIR == currentoption ||
+			OPTION_CACHE_SIZE == currentoption || OPTION_FORMAT == currentoption ||
+			OPTION_SERVER == currentoption || OPTION_STATS == currentoption ||
+			OPTION_TREE == currentoption)
+		{
+			fputs("Option not permitted in the builtin\n", stderr);
+			return EX_USAGE;
+		}
+	#endif
+		switch(currentoption)
+		{
+		case '!':
+			puts(
+				"Typical usage: . <(jkparse [OPTIONS...] [JSON])\n"
+				"  Parse JSON and return shell code for variable initialization based on the\n"
+				"JSON contents.  This will read the JSON to parse either from the first non-\n"
+				"option argument or, if one is not present, from stdin.  The returned shell code\n"
+				"can be processed by bash v4+, ksh93, or zsh v5.5+.  Two variable declarations\n"
+				"are output:\n"
+				"  JSON_TYPE - this is a single character describing the detected type of the\n"
+				"JSON argument.  This character is the first character for one of the following\n"
+				"types: null, boolean, int, double, string, array, or object.  The type will be\n"
+				"null if JSON cannot be represented by one of the other types.\n"
+				"  JSON_OBJ - this is the parsed result.  It is formatted based on JSON_TYPE as\n"
+				"one of the following:\n"
+				" null - empty string\n"
+				" boolean - string containing either 'true' or 'false'\n"
+				" int, double - decimal string value\n"
+				" string - string value without quotes or JSON escapes\n"
+				" array - array containing a string representation of each member\n"
+				" object - associative array containing a string representation of each member\n"
+				"  Output values whose type is neither string nor null can always be fed back\n"
+				"through this program, without modification, for further processing.  String and\n"
+				"null typed output values can also be fed back through, without modification, if\n"
+				"the --quote-strings option is specified when the output is generated.\n"
+				"  There is no special handling for duplicated keys in objects.  When there are\n"
+				"duplicate keys, multiple assignments will be output in the order that the keys\n"
+				"appear in the original JSON.\n"
+				"  Input is not stream processed unless the -S option is specified.\n"
+				"  Input compressed with gzip or zstd is decompressed as it is read, when this\n"
+				"is built with support for the format, as listed by --version as USE_ZLIB or\n"
+				"USE_ZSTD, respectively.  Anything following the last gzip member or zstd\n"
+				"frame is ignored.\n"
+				"\n"
+				"OPTIONS:\n"
+				" -a, --array-var=JSON_OBJ_TYPES\n"
+				"    When JSON_OBJ is either an array or object type, declare a third variable,\n"
+				"  named JSON_OBJ_TYPES, that contains an array or associative array containing\n"
+				"  characters corresponding to the types of the array or object's members,\n"
+				"  respectively.  The characters in this array are the same characters used in\n"
+				"  JSON_TYPE.  When JSON_OBJ_TYPES is an empty string, which is the default,\n"
+				"  this variable declaration is omitted from the output\n"
+				" -b, --index-base=BASE\n"
+				"    The index of the first member of an array in a path given with -p.  The\n"
+				"  default is 0.  Specify 1 for the convention of zsh\n"
+				" -e, --empty-key=EMPTY_KEY\n"
+				"    Empty keys are valid in JSON but not in shell script arrays.  Specify a\n"
+				"  string to replace empty keys with.  The default is $'\\1'.  This value must\n"
+				"  be suitable for shell use.  No verification or substitution in the output is\n"
+				"  made for a non-empty value that is specified here.  If EMPTY_KEY is an empty\n"
+				"  string, object values with empty keys will be excluded from the output\n"
+				" -f, --flatten\n"
+				"    When JSON_OBJ is either an array or object type, declare it as a single\n"
+				"  associative array of every nested value that is a scalar or an empty array or\n"
+				"  object, keyed by its path, such as [spec.containers[0].image].  Object keys\n"
+				"  are joined by SEPARATOR, and array indices are enclosed in brackets, offset\n"
+				"  by the -b BASE.  JSON_OBJ_TYPES is keyed likewise\n"
+				" -j, --print-json\n"
+				"    Rather than shell code, output the JSON text of the parsed value, or of the\n"
+				"  value at the path given with -p, without a trailing newline.  Strings are\n"
+				"  quoted and escaped, so the output is suitable for input into this program\n"
+				" -l, --local-declarations\n"
+				"    Declare variables using the local keyword rather than the default, typeset\n"
+				" -m, --multiple[=numbered]\n"
+				"    Parse a series of JSON texts, such as newline delimited JSON, and output\n"
+				"  the declarations for each, followed by a NUL character.  E.g., in bash:\n"
+				"      while IFS= read -rd '' CODE;do eval \"$CODE\"; ...; done < <(jkparse -m)\n"
+				"  If numbered is specified, the declarations are instead not followed by a NUL\n"
+				"  character, and the number of the text, counting from 1, is appended to each\n"
+				"  variable name following an underscore, e.g. JSON_OBJ_1.  With -j, the JSON\n"
+				"  text for each is followed by a newline.  A parse error is output for the text\n"
+				"  in which it occurs, and the input is then skipped up to the next newline.\n"
+				"  The exit code is that of the last text with an error, otherwise 0\n"
+				" -o, --obj-var=JSON_OBJ\n"
+				"    Specify a variable name for JSON_OBJ other than the default, JSON_OBJ.\n"
+				"  If blank, the object and array variables will be omitted from the output\n"
+				" -p, --path=KEY\n"
+				"    Output the nested value that is found by successively following each KEY,\n"
+				"  in the order given, rather than the top level value.  This option may be\n"
+				"  repeated.  For arrays, KEY is an index, and negative indices count back from\n"
+				"  the end.  If there is no value at the path, the output is the same as for a\n"
+				"  parse error, and the exit code is 65.  KEY options that precede --set are\n"
+				"  instead that option's path\n"
+				" -q, --quote-strings\n"
+				"    Include quotations around output string values, and escape as necessary to\n"
+				"  generate valid JSON, so that they can be fed back through this program with\n"
+				"  corresponding type detection.  For the sake of subsequent encoding, the type\n"
+				"  indicator for strings will be 'q' with this option instead of 's'.  With this\n"
+				"  option, null values will also be explictily output as null, rather than as\n"
+				"  empty strings\n"
+				" -r, --raw\n"
+				"    Output each member of a top level array or object that is a number, array,\n"
+				"  or object, or a top level number, exactly as it appears in the input, rather\n"
+				"  than as json-c formats it.  Nested values are then not re-serialized, and\n"
+				"  numbers keep their original form, such as -0 or integers too large for 64\n"
+				"  bits.  Members are output as with -S, which this implies.  This has no\n"
+				"  effect with the -j, -m, -p, --merge, or --set options, or when JSON_OBJ is\n"
+				"  blank, and with -f, it only applies to a top level number\n"
+				" -s, --stringify\n"
+				"    Take the input and output it escaped as a JSON string, without surrounding\n"
+				"  quotes, whitespace, or shell escapes.  This is a formatting-only function\n"
+				"  that is intended for use in constructing JSON text.  The only other option\n"
+				"  that this may be logically combined with is -q, which only adds surrounding\n"
+				"  quotes in the output when combined\n"
+				" -S, --stream\n"
+				"    When the top level value is an array or object, output each member as soon\n"
+				"  as it has been parsed, and then free it, rather than parsing the whole input\n"
+				"  first.  Memory use is then bound by the size of the largest member, apart from\n"
+				"  the member types buffered for JSON_OBJ_TYPES.  Each duplicated key is output\n"
+				"  in every place that it occurs, so with -f, the members flattened from an\n"
+				"  earlier occurrence of a key remain.  If there is a parse error after output\n"
+				"  has begun, JSON_OBJ is declared again as a null value, and JSON_OBJ_TYPES\n"
+				"  is unset.  This has no effect with the -j, -m, -p, --merge, or --set\n"
+				"  options, or when JSON_OBJ is blank\n"
+				" -t, --type-var=JSON_TYPE\n"
+				"    Specify a variable name for JSON_TYPE other than the default, JSON_TYPE.\n"
+				"  If blank, the type variable will be omitted from the output\n"
+				" -u, --unset-vars\n"
+				"    Output commands to unset JSON_OBJ and, if defined, JSON_OBJ_TYPES, before\n"
+				"  outputting their new declarations.  This permits re-using the same variable\n"
+				"  names, and using JSON_OBJ for both input and output, while transversing an\n"
+				"  object\n"
+				" -v, --short-version\n"
+				"    Output just the version number and exit\n"
+				" -V, --verbose\n"
+				"    If there is a parse error, output a descriptive message to stderr\n"
+				" --help\n"
+				"    This help screen\n"
+				" --cache-dir=DIR\n"
+				"    Keep the output in DIR, in a file named by a SHA-256 digest of the input\n"
+				"  and of the options that affect the output.  When the same input is given\n"
+				"  with the same options again, the output is read back from that file rather\n"
+				"  than generated.  The input is read in full before any output.  Only output\n"
+				"  with an exit code of 0 is kept.  Files are written atomically, and once their\n"
+				"  total size exceeds the cache size, the least recently used are removed.  DIR\n"
+				"  is created if necessary, with access for the user only.  Since the files\n"
+				"  hold shell code, DIR is not used unless it is owned by the user and cannot\n"
+				"  be written by others, and a file is not used unless it is owned by the user.\n"
+				"  If DIR cannot be used, the output is still generated, with the error\n"
+				"  reported with -V\n"
+				" --cache-size=SIZE\n"
+				"    Specify the size of the files kept with --cache-dir, in bytes, or with a\n"
+				"  suffix of K, M, or G.  The default is 64M\n"
+				" --encode[=compact]\n"
+				"    Perform the reverse operation: read shell declarations, as output by\n"
+				"  typeset -p, and output the JSON text of JSON_OBJ, without a trailing newline.\n"
+				"  The declarations are read from the first non-option argument or from stdin.\n"
+				"  Member types are taken from JSON_OBJ_TYPES, given with -a, or for a scalar,\n"
+				"  from JSON_TYPE, given with -t.  Values of type 's' are escaped as strings.\n"
+				"  Values of type 'n', and empty values of any other type, are output as null.\n"
+				"  All other values are output as they are, so output from -q can be encoded\n"
+				"  without types.  Keys equal to EMPTY_KEY are encoded as empty keys.\n"
+				"  Unset array indices are filled with null, unless compact is specified.  The\n"
+				"  exit code is 65 if JSON_OBJ is not declared, if JSON_OBJ_TYPES is not the\n"
+				"  same kind of array as JSON_OBJ, or if the input is malformed\n"
+				" --file=PATH\n"
+				"    Read the input from the file at PATH rather than from stdin.  A regular\n"
+				"  file is mapped into memory and parsed in place, rather than being read\n"
+				"  through a buffer, and no JSON argument may be given\n"
+				" --flatten-escape=ESCAPE\n"
+				"    Specify the character inserted by -f before every occurrence of itself, '[',\n"
+				"  or the first character of SEPARATOR in a key, so that paths are unambiguous.\n"
+				"  The default is '\\'.  If blank, keys are not escaped\n"
+				" --flatten-separator=SEPARATOR\n"
+				"    Specify the string joining object keys in paths with -f.  The default is '.'\n"
+				" --format=FORMAT\n"
+				"    Output records of the value and its members rather than shell code, so that\n"
+				"  they are read without being evaluated, with FORMAT nul or binary, or shell\n"
+				"  for the default.  The first record is of the value itself, with an empty key,\n"
+				"  and for an array or object, an empty value.  A record follows for each\n"
+				"  member, or with -f, each nested value, keyed by its index, key, or path.  The\n"
+				"  type and value of each are those of JSON_OBJ_TYPES and JSON_OBJ, without\n"
+				"  shell escapes, and empty keys are kept.  For nul, the key, type, and value\n"
+				"  are each followed by a NUL character, e.g., in bash:\n"
+				"      mapfile -d '' FIELDS < <(jkparse --format=nul)\n"
+				"  A string value is then cut off at any NUL character of its own, unless it is\n"
+				"  escaped with -q.  For binary, each record is its type character followed by\n"
+				"  its key and its value, each preceded by its length as a 64 bit little-endian\n"
+				"  integer, so that a string value is output in full.  This has no effect with\n"
+				"  -j, cannot be given with -m or --server, and the variable name options, -r,\n"
+				"  -S, and --shell have no effect with it\n"
+				" --group\n"
+				"    Begin a group of options that declares further variables in the same\n"
+				"  output, so that the values of several inputs, or several values of one, are\n"
+				"  declared by a single process.  The options preceding the first --group are\n"
+				"  the defaults for every group, and a group's -p KEYs follow the defaults'.\n"
+				"  The input of a group is its JSON argument or --file, or otherwise the input\n"
+				"  of the defaults, and each input is parsed once, however many groups share\n"
+				"  it.  Each group must declare variables of other names than every other\n"
+				"  group, including the type variable, and the exit code is 64 if one does\n"
+				"  not.  E.g.:\n"
+				"      . <(jkparse --group -o SPEC -t SPEC_TYPE -p spec \\\n"
+				"          --group -o STATUS -t STATUS_TYPE -p status)\n"
+				"  The output of every group is written at once, at the end.  The exit code is\n"
+				"  that of the last group with an error, otherwise 0.  This cannot be given with\n"
+				"  -j, -m, -s, --cache-dir, --encode, --format, --server, or --set, and -r and\n"
+				"  -S have no effect with it.  --merge may only be given in the defaults.  This\n"
+				"  is only recognized in full, not abbreviated\n"
+				" --range=START:END\n"
+				"    When the value output is an array, output only its members from index\n"
+				"  START up to, but not including, index END, as an array of just those\n"
+				"  members.  Either may be omitted, for the first member or past the last.\n"
+				"  Indices are offset by the -b BASE, and negative indices count back from the\n"
+				"  end, in which case the input is not streamed.  This has no effect with -j,\n"
+				"  and with -f, it applies to the members of the top level array\n"
+				" --select=KEY\n"
+				"    When the value output is an object, output only its members whose key is\n"
+				"  KEY.  Other members are skipped without being escaped.  This option may be\n"
+				"  repeated to select several keys.  This has no effect with -j, and with -f,\n"
+				"  it applies to the members of the top level object\n"
+				" --server[=FIFO]\n"
+				"    Process a series of requests, read from stdin or from FIFO, in a single\n"
+				"  process.  Each request is the list of arguments that would otherwise be given\n"
+				"  on the command line, with every argument terminated by a NUL character.  The\n"
+				"  first non-option argument is the JSON to parse, which completes the request.\n"
+				"  The options from the command line are the defaults for each request, and any\n"
+				"  options other than -m, -s, -v, --cache-dir, --cache-size, --file, --format,\n"
+				"  --help, --merge, --server, --stats, and --version may be given per request.\n"
+				"  The output for each request is followed by a NUL character.  FIFO is\n"
+				"  re-opened whenever its writer closes it.  E.g., in bash:\n"
+				"      coproc JKPARSE { jkparse --server; }\n"
+				"      printf '%s\\0' -a TYPES '{\"a\":1}' >&${JKPARSE[1]}\n"
+				"      IFS= read -rd '' CODE <&${JKPARSE[0]}; eval \"$CODE\"\n"
+				" --set=JSON\n"
+				"    Before any output, assign the value parsed from JSON at the path given by\n"
+				"  the -p options preceding this one and following any previous --set.  The\n"
+				"  last KEY is added to an object, or replaces the value if present, and for an\n"
+				"  array, an index past the end extends it with null values.  This option may\n"
+				"  be repeated, with the edits applied in order.  The exit code is 1 if a value\n"
+				"  along the path is not an array or object, 3 if it does not exist, or the\n"
+				"  exit code for a parse error if JSON is invalid\n"
+				" --shell=SHELL\n"
+				"    Output the form of shell code that SHELL evaluates fastest, rather than the\n"
+				"  form that bash, ksh, and zsh all evaluate.  SHELL may only be bash, for which\n"
+				"  each array or object is declared empty, and then each member is assigned by\n"
+				"  a separate command, which bash 5.2 evaluates in 60% to 75% of the time of a\n"
+				"  single compound assignment\n"
+				" --stats[=FILE]\n"
+				"    At exit, output statistics as a line of JSON to FILE, or to stderr: the wall\n"
+				"  and CPU time spent reading, parsing, escaping keys, quoting values, and\n"
+				"  writing output, the bytes read and written, the members output, the key\n"
+				"  subscripts that needed escaping, the strings escaped for the shell, and of\n"
+				"  those, the number quoted, or the printf processes run, and the peak RSS.\n"
+				"  Timing adds some overhead for each key and value.  With --server, the\n"
+				"  statistics cover every request\n"
+				" --tree\n"
+				"    When the value output is an array or object, declare each array or object\n"
+				"  nested in it as a variable of its own, so that the whole document can be\n"
+				"  traversed without further parsing.  Each is named by JSON_OBJ followed by an\n"
+				"  underscore and its number, counting from 1 in the order declared, e.g.\n"
+				"  JSON_OBJ_1, which the member holds in place of its JSON text.  With -a, its\n"
+				"  types are likewise declared in JSON_OBJ_TYPES_1, which tells these names\n"
+				"  apart from strings.  A member is then reached by a name reference, e.g., in\n"
+				"  bash:\n"
+				"      typeset -n SPEC=${JSON_OBJ[spec]}; echo \"${SPEC[name]}\"\n"
+				"  --select and --range apply to the members of the top level value.  This has\n"
+				"  no effect with -f, -j, or --format, and -r and -S have no effect with it\n"
+				" --version\n"
+				"    Output version, copyright, and build options, then exit\n"
+				"  Any non-empty variable name specified via an option will appear verbatim in\n"
+				"the output without additional verification.  Additional options for variable\n"
+				"declaration may be specified in the -a, -o, and -t option arguments.  E.g.,\n"
+				"-o '-g JSON_OBJ' will promote the scope of the object's declaration in BASH."
+			);
+			return EXIT_SUCCESS;
+		case 'a':
+			options.arrayVarName = optarg;
 			break;
-		case json_type_object:
-			objTypeChar = 'o';
-			printTypeAndBeginObjWithType(associativeDeclareType);
-			putc_unlocked('(', stdout);
+		case 'b':
 			{
-				void valPrintWithoutQuotedStrings(json_object * val)
+				char * end;
+				options.indexBase = strtol(optarg, &end, 10);
+				if(! *optarg || *end)
 				{
-					putShEscapedString(json_object_get_string(val));
+					fprintf(stderr, "Invalid index base: %s\n", optarg);
+					return EX_USAGE;
 				}
-				printObject(quoteStrings ? valPrintWithQuotedStrings : valPrintWithoutQuotedStrings);
 			}
-			if(*arrayVarName)
+			break;
+		case 'e':
+			options.emptyKey = optarg;
+			break;
+		case OPTION_ENCODE:
+			if(optarg && strcmp(optarg, "compact"))
 			{
-				void valTypePrint(json_object * val)
-				{
-					putc_unlocked(*json_type_to_name(json_object_get_type(val)), stdout);
-				}
-				void valTypePrintWithQForStrings(json_object * val)
-				{
-					char typeChar = *json_type_to_name(json_object_get_type(val));
-					putc_unlocked('s' == typeChar ? 'q' : typeChar, stdout);
-				}
-				printArrayClosureAndBeginArrayVar(associativeDeclareType);
-				printObject(quoteStrings ? valTypePrintWithQForStrings : valTypePrint);
+				fprintf(stderr, "Invalid encoding mode: %s\n", optarg);
+				return EX_USAGE;
 			}
-			puts(")");
+			options.encode = 1;
+			options.encodeCompact = NULL != optarg;
 			break;
-		case json_type_array:
-			objTypeChar = 'a';
-			printTypeAndBeginObjWithType(arrayDeclareType);
-			putc_unlocked('(', stdout);
+		case 'f':
+			options.flatten = 1;
+			break;
+		case OPTION_FILE:
+			inputFile = optarg;
+			break;
+		case OPTION_FLATTEN_ESCAPE:
+			if(*optarg && optarg[1])
+			{
+				fputs("The flatten escape must be a single character\n", stderr);
+				return EX_USAGE;
+			}
+			options.flattenEscape = *optarg;
+			break;
+		case OPTION_FLATTEN_SEPARATOR:
+			options.flattenSeparator = optarg;
+			break;
+		case OPTION_FORMAT:
+			if(! strcmp(optarg, "shell"))
+				options.format = FORMAT_SHELL;
+			else if(! strcmp(optarg, "nul"))
+				options.format = FORMAT_NUL;
+			else if(! strcmp(optarg, "binary"))
+				options.format = FORMAT_BINARY;
+			else
+			{
+				fprintf(stderr, "Invalid format: %s\n", optarg);
+				return EX_USAGE;
+			}
+			break;
+		case 'j':
+			options.printJson = 1;
+			break;
+		case 'l':
+			options.declareStr = "local";
+			break;
+		case 'm':
+			if(optarg && strcmp(optarg, "numbered"))
+			{
+				fprintf(stderr, "Invalid multiple document mode: %s\n", optarg);
+				return EX_USAGE;
+			}
+			options.multiple = 1;
+			options.multipleNumbered = NULL != optarg;
+			break;
+		case 'o':
+			options.objVarName = optarg;
+			break;
+		case 'p':
+			if(options.pathLength >= pathCapacity)
+			{
+				pathCapacity = pathCapacity ? pathCapacity * 2 : 8;
+				if(! (pathComponents = realloc(pathComponents, pathCapacity * sizeof(*pathComponents))))
+					return EX_OSERR;
+			}
+			pathComponents[options.pathLength++] = optarg;
+			break;
+		case 'q':
+			options.quoteStrings = 1;
+			break;
+		case 'r':
+			options.raw = 1;
+			break;
+		case 't':
+			options.typeVarName = optarg;
+			break;
+		case 'S':
+			options.stream = 1;
+			break;
+		case 's':
+			options.stringify = 1;
+			break;
+		case 'u':
+			options.unsetVars = 1;
+			break;
+		case 'v':
+			fputs_unlocked(JKPRINT_VERSION_STRING "\n", stdout);
+			return EXIT_SUCCESS;
+			break;
+		case 'V':
+			options.verbose = 1;
+			break;
+		case '@':
+			fputs_unlocked(JKPRINT_VERSION_STRING_LONG "Compiled with:\n", stdout);
+			fputs_unlocked(buildOptions, stdout);
+			return EXIT_SUCCESS;
+			break;
+		case OPTION_SERVER:
+			serverFifo = optarg ? optarg : "";
+			break;
+		case OPTION_CACHE_DIR:
+			cacheDir = optarg;
+			break;
+		case OPTION_CACHE_SIZE:
 			{
-				void arrayValPrintWithoutQuotedStrings(json_object * objAtIndex)
+				static const char suffixes[] = "KMG";
+				const char * suffix;
+				char * end;
+				long long multiplier = 1;
+				errno = 0;
+				cacheSize = strtoll(optarg, &end, 10);
+				if(optarg != end && *end && (suffix = strchr(suffixes, *end)))
 				{
-					if(NULL == objAtIndex)
-						fputs_unlocked("''", stdout);
-					else
-						putShEscapedString(json_object_get_string(objAtIndex));
+					multiplier <<= 10 * (suffix - suffixes + 1);
+					end++;
 				}
-				void (*valPrint)(json_object *) = quoteStrings
-					? valPrintWithQuotedStrings : arrayValPrintWithoutQuotedStrings;
-				int arrayLength = json_object_array_length(obj);
-				for(int index = 0; index < arrayLength; index++)
+				if(optarg == end || *end || errno || 0 > cacheSize || LLONG_MAX / multiplier < cacheSize)
 				{
-				#ifdef TRIM_ARRAY_LEADING_SPACE
-					if(index)
-				#endif
-						putc_unlocked(' ', stdout);
-					valPrint(json_object_array_get_idx(obj, index));
+					fprintf(stderr, "Invalid cache size: %s\n", optarg);
+					return EX_USAGE;
 				}
-				if(*arrayVarName)
+				cacheSize *= multiplier;
+			}
+			break;
+		case OPTION_RANGE:
+			{
+				//  Either bound may be omitted, but not the ':'
+				char * colon = strchr(optarg, ':');
+				char * end = colon;
+				options.range = 1;
+				options.rangeStart = LONG_MIN;
+				options.rangeEnd = LONG_MAX;
+				errno = 0;
+				if(colon && optarg != colon)
+					options.rangeStart = strtol(optarg, &end, 10);
+				if(colon && colon == end && colon[1])
+					options.rangeEnd = strtol(colon + 1, &end, 10);
+				else if(colon && colon == end)
+					end++;
+				if(! colon || errno || *end)
 				{
-					printArrayClosureAndBeginArrayVar(arrayDeclareType);
-					if(quoteStrings)
-					{
-						for(int index = 0; index < arrayLength; index++)
-						{
-						#ifdef TRIM_ARRAY_LEADING_SPACE
-							if(index)
-						#endif
-								putc_unlocked(' ', stdout);
-							char typeChar = *json_type_to_name(json_object_get_type(
-								json_object_array_get_idx(obj, index)));
-							putc_unlocked('s' == typeChar ? 'q' : typeChar, stdout);
-						}
-					}
-					else
-					{
-						for(int index = 0; index < arrayLength; index++)
-						{
-						#ifdef TRIM_ARRAY_LEADING_SPACE
-							if(index)
-						#endif
-								putc_unlocked(' ', stdout);
-							putc_unlocked(*json_type_to_name(json_object_get_type(
-								json_object_array_get_idx(obj, index))), stdout);
-						}
-					}
+					fprintf(stderr, "Invalid range: %s\n", optarg);
+					return EX_USAGE;
 				}
 			}
-			puts(")");
 			break;
-		case json_type_string:
-			(
-				quoteStrings ?
-				({
-					objTypeChar = 'q';
-					printTypeAndBeginObj();
-					putShEscapedAndQuotedJsonString;
-				}) : ({
-					objTypeChar = 's';
-					printTypeAndBeginObj();
-					putShEscapedString;
-				})
-			)(json_object_get_string(obj));
-			putc_unlocked('\n', stdout);
+		case OPTION_MERGE:
+			if(options.mergeCount >= mergeCapacity)
+			{
+				mergeCapacity = mergeCapacity ? mergeCapacity * 2 : 8;
+				if(! (mergeFiles = realloc(mergeFiles, mergeCapacity * sizeof(*mergeFiles))) ||
+					! (mergePatches = realloc(mergePatches, mergeCapacity * sizeof(*mergePatches))))
+					return EX_OSERR;
+			}
+			mergeFiles[options.mergeCount++] = optarg;
+			break;
+		case OPTION_SELECT:
+			if(options.selectCount >= selectCapacity)
+			{
+				selectCapacity = selectCapacity ? selectCapacity * 2 : 8;
+				if(! (selectedKeys = realloc(selectedKeys, selectCapacity * sizeof(*selectedKeys))))
+					return EX_OSERR;
+			}
+			selectedKeys[options.selectCount++] = optarg;
+			break;
+		case OPTION_SHELL:
+			//  Only shells whose evaluation of their form has been measured are accepted
+			if(! strcmp(optarg, "bash"))
+				options.shell = SHELL_BASH;
+			else
+			{
+				fprintf(stderr, "Invalid shell: %s\n", optarg);
+				return EX_USAGE;
+			}
+			break;
+		case OPTION_STATS:
+			statsPath = optarg ? optarg : "";
+			break;
+		case OPTION_TREE:
+			options.tree = 1;
+			break;
+		case OPTION_SET:
+			if(options.pathLength == options.pathStart)
+			{
+				fputs("--set requires a path given with -p\n", stderr);
+				return EX_USAGE;
+			}
+			if(options.editCount >= editCapacity)
+			{
+				editCapacity = editCapacity ? editCapacity * 2 : 8;
+				if(! (edits = realloc(edits, editCapacity * sizeof(*edits))))
+					return EX_OSERR;
+			}
+			edits[options.editCount++] = (struct jkparseEdit){.pathStart = options.pathStart,
+				.pathLength = options.pathLength - options.pathStart, .value = optarg};
+			options.pathStart = options.pathLength;
 			break;
+		case '?':
+			fprintf(stderr, "Invalid option: -%c\n", optopt);
+			#if defined(__GNUC__) && __GNUC__ >= 7
+				__attribute__((fallthrough));
+			#endif
+		default:
+			return EX_USAGE;
 		}
 	}
-	else if(*typeVarName)
+	if(options.selectCount)
+		buildSelectedKeySet();
+	return -1;
+}
+
+
+#ifndef JKPARSE_BUILTIN
+//  Read requests consisting of NUL terminated arguments from stdin or serverFifo, and output the
+// shell code for each followed by a NUL character.  The tokener and stdout's buffer are reused
+// across requests.
+static int serveRequests(char * argv0)
+{
+	FILE * input = stdin;
+	if(*serverFifo && ! (input = fopen(serverFifo, "r")))
+	{
+		fprintf(stderr, "Unable to open %s: %s\n", serverFifo, strerror(errno));
+		return EX_NOINPUT;
+	}
+	__fsetlocking(input, FSETLOCKING_BYCALLER);
+	struct json_tokener * tok = json_tokener_new();
+	if(! tok)
+		return EX_OSERR;
+	const struct jkparseOptions defaultOptions = options;
+	//  Request arguments, with argv[0] reserved for getopt.  The buffers allocated by getdelim()
+	// are kept in requestArgBuffers, since getopt may permute requestArgv, and are reused across
+	// requests.
+	char ** requestArgv = NULL;
+	char ** requestArgBuffers = NULL;
+	size_t * requestArgSizes = NULL;
+	int requestArgCapacity = 0;
+	int requestArgc = 1;
+	//  0 while reading options, 1 when the next argument is an option's, and 2 after "--"
+	int argState = 0;
+	while(1)
 	{
-		char typeChar = *json_type_to_name(type);
-		printf("%s %s=%c\n", declareStr, typeVarName,
-			's' == typeChar && quoteStrings ? 'q' : typeChar);
+		if(requestArgc >= requestArgCapacity)
+		{
+			int newCapacity = requestArgCapacity ? requestArgCapacity * 2 : 16;
+			if(! (requestArgv = realloc(requestArgv, (newCapacity + 1) * sizeof(*requestArgv))) ||
+				! (requestArgBuffers = realloc(requestArgBuffers,
+					newCapacity * sizeof(*requestArgBuffers))) ||
+				! (requestArgSizes = realloc(requestArgSizes,
+					newCapacity * sizeof(*requestArgSizes))))
+				return EX_OSERR;
+			for(; requestArgCapacity < newCapacity; requestArgCapacity++)
+			{
+				requestArgBuffers[requestArgCapacity] = NULL;
+				requestArgSizes[requestArgCapacity] = 0;
+			}
+		}
+		STATS_SET_PHASE(STATS_READ);
+		ssize_t argLength = getdelim(requestArgBuffers + requestArgc, requestArgSizes + requestArgc,
+			0, input);
+		STATS_SET_PHASE(STATS_PARSE);
+		if(0 > argLength)
+		{
+			if(ferror_unlocked(input))
+			{
+				fprintf(stderr, "Error reading request: %s\n", strerror(errno));
+				return EX_IOERR;
+			}
+			//  A partial request at the end of the input is discarded
+			requestArgc = 1;
+			argState = 0;
+			if(input == stdin)
+				break;
+			//  Wait for the next writer to the FIFO
+			fclose(input);
+			if(! (input = fopen(serverFifo, "r")))
+			{
+				fprintf(stderr, "Unable to open %s: %s\n", serverFifo, strerror(errno));
+				return EX_NOINPUT;
+			}
+			__fsetlocking(input, FSETLOCKING_BYCALLER);
+			continue;
+		}
+		stats.bytesRead += argLength;
+		const char * arg = requestArgBuffers[requestArgc++];
+		if(1 == argState)
+		{
+			argState = 0;
+			continue;
+		}
+		if(! argState && '-' == *arg && arg[1])
+		{
+			if('-' == arg[1] && ! arg[2])
+				argState = 2;
+			else
+				argState = optionTakesNextArgument(arg);
+			continue;
+		}
+		//  The first non-option argument is the JSON, which completes the request
+		requestArgv[0] = argv0;
+		memcpy(requestArgv + 1, requestArgBuffers + 1, (requestArgc - 1) * sizeof(*requestArgv));
+		requestArgv[requestArgc] = NULL;
+		options = defaultOptions;
+		int rc = parseOptions(requestArgc, requestArgv, OPTIONS_SERVER_REQUEST);
+		if(-1 == rc && options.encode)
+			encodeShellVariables(requestArgv[optind]);
+		else if(-1 == rc && isStreamed())
+		{
+			inputText = requestArgv[optind];
+			inputTextLength = strlen(inputText) + 1;
+			streamInput();
+		}
+		else if(-1 == rc)
+		{
+			enum json_tokener_error parseError = json_tokener_success;
+			jsonValue obj = JSON_C_VALUE(NULL);
+		#ifdef USE_TAPE_PARSER
+			if(! options.editCount && ! options.mergeCount)
+				obj = tapeParse(requestArgv[optind], strlen(requestArgv[optind]));
+			if(! obj.entry)
+		#endif
+				obj = JSON_C_VALUE(parseString(tok, requestArgv[optind], &parseError));
+			outputResult(obj, parseError);
+			json_object_put(JSON_C_OBJECT(obj));
+		}
+		else
+			fprintf(output, "(exit %d)\n", rc);
+		putc_unlocked(0, output);
+		STATS_SET_PHASE(STATS_OUTPUT);
+		fflush_unlocked(output);
+		requestArgc = 1;
+		argState = 0;
 	}
-	//json_object_put(obj);
-	if(parseError)
-		printf("(exit %d)\n", parseError);
-	return parseError;
+	json_tokener_free(tok);
+	return EXIT_SUCCESS;
+}
+
+
+//  With --group, the options following each --group argument are applied over the defaults, which
+// are the options preceding the first, and declare variables from the group's own input, given as
+// an argument or with --file, or otherwise from the input of the defaults.  Each input is parsed
+// once, however many groups share it, and the output of every group is written at once at the
+// end, so that a shell script's several invocations at startup can be replaced by one.
+
+//  A document parsed for the groups, from the file given with --file, or from the input of the
+// defaults when file is NULL
+struct groupDocument
+{
+	const char * file;
+	jsonValue val;
+	enum json_tokener_error parseError;
+};
+
+//  Parse the current input as the document for file, and add it to documents
+static struct groupDocument * addGroupDocument(struct groupDocument ** documents,
+	int * documentCount, const char * file)
+{
+	if(! (*documents = realloc(*documents, (*documentCount + 1) * sizeof(**documents))))
+		exit(EX_OSERR);
+	struct groupDocument * document = *documents + (*documentCount)++;
+	document->file = file;
+	STATS_SET_PHASE(STATS_PARSE);
+	document->val = parseDocument(&document->parseError);
+#ifdef USE_TAPE_PARSER
+	if(document->val.entry)
+		keepTape();
+#endif
+	return document;
+}
+
+
+//  Output the declarations of each group, whose arguments begin at start, each following a --group
+// argument.  Return the exit code of the last group that failed, or 0 if none did.
+static int outputGroups(int argc, char ** argv, int start)
+{
+	const struct jkparseOptions defaultOptions = options;
+	const char * defaultFile = inputFile;
+	//  The index of each group's --group argument, which is replaced by argv[0] for getopt
+	int * groupStarts = malloc((argc - start + 2) * sizeof(*groupStarts));
+	int groupCount = 0;
+	if(! groupStarts)
+		return EX_OSERR;
+	for(int arg = start; arg < argc; arg = nextGroup(argc, argv, arg + 1))
+		groupStarts[groupCount++] = arg;
+	groupStarts[groupCount] = argc;
+	//  The names of the variables declared by each group, which must differ from those of every
+	// other group, so that a group cannot silently redeclare the variables of an earlier one
+	const char ** varNames = malloc(groupCount * 3 * sizeof(*varNames));
+	if(! varNames)
+		return EX_OSERR;
+	//  Every group's options are checked before any input is read, and the input of the defaults is
+	// then parsed first if any group uses it, since a group's file that is not a regular file is
+	// then read from inputFd in place of stdin
+	int usesDefaultInput = 0;
+	for(int group = 0; group < groupCount; group++)
+	{
+		int groupArgc = groupStarts[group + 1] - groupStarts[group];
+		char ** groupArgv = argv + groupStarts[group];
+		groupArgv[0] = argv[0];
+		options = defaultOptions;
+		inputFile = NULL;
+		int rc = parseOptions(groupArgc, groupArgv, OPTIONS_GROUP);
+		if(-1 != rc)
+			return rc;
+		if(optind < groupArgc && inputFile)
+		{
+			fputs("A JSON argument cannot be given with --file\n", stderr);
+			return EX_USAGE;
+		}
+		usesDefaultInput |= optind == groupArgc && (! inputFile ||
+			(defaultFile && ! strcmp(inputFile, defaultFile)));
+		const char * groupVarNames[3] = {options.objVarName, options.typeVarName,
+			options.arrayVarName};
+		for(int var = 0; var < 3; var++)
+		{
+			const char * name = varNames[group * 3 + var] = lastWord(groupVarNames[var]);
+			for(int earlier = 0; *name && earlier < group * 3; earlier++)
+				if(! strcmp(name, varNames[earlier]))
+				{
+					fprintf(stderr, "Group %d declares %s, as group %d does\n", group + 1, name,
+						earlier / 3 + 1);
+					return EX_USAGE;
+				}
+		}
+	}
+	free(varNames);
+	struct groupDocument * documents = NULL;
+	int documentCount = 0;
+	if(usesDefaultInput)
+	{
+		options = defaultOptions;
+		addGroupDocument(&documents, &documentCount, NULL);
+	}
+	FILE * groupsOutput = output;
+	char * buffer = NULL;
+	size_t size = 0;
+	if(! (output = open_memstream(&buffer, &size)))
+		return EX_OSERR;
+	__fsetlocking(output, FSETLOCKING_BYCALLER);
+	int lastFailure = EXIT_SUCCESS;
+	for(int group = 0; group < groupCount; group++)
+	{
+		int groupArgc = groupStarts[group + 1] - groupStarts[group];
+		char ** groupArgv = argv + groupStarts[group];
+		int rc;
+		options = defaultOptions;
+		inputFile = NULL;
+		parseOptions(groupArgc, groupArgv, OPTIONS_GROUP);
+		if(optind < groupArgc)
+		{
+			//  A group's argument is only parsed for that group
+			enum json_tokener_error parseError;
+			inputText = groupArgv[optind];
+			inputTextLength = strlen(inputText) + 1;
+			stats.bytesRead += inputTextLength - 1;
+			STATS_SET_PHASE(STATS_PARSE);
+			jsonValue val = parseDocument(&parseError);
+			rc = outputResult(val, parseError);
+			json_object_put(JSON_C_OBJECT(val));
+		}
+		else
+		{
+			const char * file = inputFile && (! defaultFile || strcmp(inputFile, defaultFile)) ?
+				inputFile : NULL;
+			struct groupDocument * document = NULL;
+			for(int index = 0; index < documentCount && ! document; index++)
+				if(file == documents[index].file ||
+					(file && documents[index].file && ! strcmp(file, documents[index].file)))
+					document = documents + index;
+			inputText = NULL;
+			if(! document && ! (rc = mapInputFile(file)))
+				document = addGroupDocument(&documents, &documentCount, file);
+			if(document)
+				rc = outputResult(document->val, document->parseError);
+		}
+		if(rc)
+		{
+			lastFailure = rc;
+			if(options.verbose)
+				fprintf(stderr, "Error in group %d\n", group + 1);
+		}
+	}
+	fclose(output);
+	output = groupsOutput;
+	STATS_SET_PHASE(STATS_OUTPUT);
+	stats.bytesWritten += writeAll(1, buffer, size);
+	free(buffer);
+	return lastFailure;
+}
+#endif
+
+
+#ifdef JKPARSE_BUILTIN
+//  As a bash loadable builtin, enabled with enable -f jkparse.so jkparse, jkparse assigns the
+// variables directly in the shell that runs it, as typeset does, rather than outputting their
+// declarations.  It takes the same options and returns the same exit codes, apart from these,
+// which it does not support:
+//  -m and -r, which output each document or member as it is read, while the builtin assigns the
+// variables from a value parsed in full
+//  --cache-dir and --cache-size, which keep the shell code that the builtin does not generate
+//  --format, which outputs records in place of the variables
+//  --group, --server, and --stats, which only concern a jkparse process
+//  --tree, whose variables are not yet assigned by assignVariables()
+//  -S is accepted without effect, and the variables are always replaced, so that -u has no further
+// effect.  The variable names must be plain identifiers.
+static struct jkparseOptions defaultOptions;
+//  Whether a variable could not be assigned, for which the exit code is 1, as it is for a
+// declaration that fails when the output is evaluated
+static int assignFailed;
+
+
+//  Declare the variable named name as typeset does, which inside a function is a local variable:
+// an empty associative array for 'A', an empty indexed array for 'a', or otherwise an empty
+// scalar.  A variable of the same scope is replaced.  Return NULL after reporting an error.
+static SHELL_VAR * declareVariable(char * name, char declareType)
+{
+	SHELL_VAR * var = find_variable(name);
+	if(! legal_identifier(name))
+	{
+		sh_invalidid(name);
+		assignFailed = 1;
+		return NULL;
+	}
+	if(var && (readonly_p(var) || noassign_p(var)))
+	{
+		if(readonly_p(var))
+			err_readonly(name);
+		assignFailed = 1;
+		return NULL;
+	}
+	if(var && var->context == variable_context)
+		unbind_variable(name);
+	if(variable_context)
+		var = 'A' == declareType ? make_local_assoc_variable(name, 0) : 'a' == declareType ?
+			make_local_array_variable(name, 0) : make_local_variable(name, 0);
+	else
+		var = 'A' == declareType ? make_new_assoc_variable(name) : 'a' == declareType ?
+			make_new_array_variable(name) : bind_variable(name, "", 0);
+	if(var)
+		VUNSETATTR(var, att_invisible);
+	return var;
+}
+
+
+//  Declare the scalar variable named name with value
+static void assignScalar(char * name, const char * value)
+{
+	SHELL_VAR * var = declareVariable(name, 0);
+	if(var)
+		bind_variable_value(var, (char *)value, 0);
+}
+
+
+//  EMPTY_KEY, parsed as the shell parses it in a subscript, or empty if it cannot be parsed
+static char * emptyKey = NULL;
+//  The array or object variable whose members assignMember() assigns, and the function that
+// returns the text of each
+static SHELL_VAR * assignedVar;
+static const char * (*assignedText)(jsonValue);
+
+//  Assign a member of assignedVar, as visitMembers() visits them
+static void assignMember(const char * key, size_t index, jsonValue val)
+{
+	if(! key)
+	{
+		bind_array_element(assignedVar, index, (char *)assignedText(val), 0);
+		return;
+	}
+	//  Empty keys are valid in JSON but not in the shell.  Assign emptyKey as the key.
+	if(! *key && ! *(key = emptyKey))
+		return;
+	bind_assoc_variable(assignedVar, assignedVar->name, savestring(key),
+		(char *)assignedText(val), 0);
+}
+
+
+//  Assign the variables describing obj, as printDeclarations() declares them
+static void assignVariables(jsonValue obj, int exitCode)
+{
+	json_type type = valueType(obj);
+	if(*options.typeVarName)
+		assignScalar(options.typeVarName, typeText(obj));
+	if(! *options.objVarName)
+		return;
+	if(json_type_array != type && json_type_object != type)
+	{
+		assignScalar(options.objVarName, valueText(obj));
+		return;
+	}
+	char declareType = json_type_object == type || options.flatten ? 'A' : 'a';
+	if((assignedVar = declareVariable(options.objVarName, declareType)))
+	{
+		assignedText = valueText;
+		visitMembers(obj, assignMember);
+	}
+	if(*options.arrayVarName && (assignedVar = declareVariable(options.arrayVarName, declareType)))
+	{
+		assignedText = typeText;
+		visitMembers(obj, assignMember);
+	}
+}
+
+
+//  Run jkparse with the arguments in list, and return its exit code
+static int jkparse_builtin(WORD_LIST * list)
+{
+	//  The arguments, with argv[0] reserved for getopt
+	int argc = 1;
+	for(WORD_LIST * word = list; word; word = word->next)
+		argc++;
+	char ** argv = malloc((argc + 1) * sizeof(*argv));
+	if(! argv)
+		exit(EX_OSERR);
+	argv[0] = "jkparse";
+	argc = 1;
+	for(WORD_LIST * word = list; word; word = word->next)
+		argv[argc++] = word->word->word;
+	argv[argc] = NULL;
+	output = stdout;
+	options = defaultOptions;
+	assignFailed = 0;
+	inputFile = NULL;
+	int rc = parseOptions(argc, argv, OPTIONS_COMMAND_LINE);
+	if(-1 == rc && nextGroup(argc, argv, 1) < argc)
+	{
+		fputs("Option not permitted in the builtin\n", stderr);
+		rc = EX_USAGE;
+	}
+	if(-1 == rc && ! variable_context && 'l' == *options.declareStr)
+	{
+		builtin_error("-l can only be used in a function");
+		rc = EXIT_FAILURE;
+	}
+	if(-1 == rc && optind < argc && inputFile)
+	{
+		fputs("A JSON argument cannot be given with --file\n", stderr);
+		rc = EX_USAGE;
+	}
+	//  The patches loaded for --merge, each of which is released below, including those loaded
+	// before one that failed
+	int mergeCount = 0;
+	if(-1 == rc && options.mergeCount)
+	{
+		mergeCount = options.mergeCount;
+		memset(mergePatches, 0, mergeCount * sizeof(*mergePatches));
+		int mergeRc = loadMergePatches();
+		if(mergeRc)
+			rc = mergeRc;
+	}
+	if(-1 == rc && inputFile)
+	{
+		int fileRc = mapInputFile(inputFile);
+		if(fileRc)
+			rc = fileRc;
+	}
+	char * input = NULL;
+	if(-1 == rc)
+	{
+		const char * emptyKeyIn = options.emptyKey;
+		char * emptyKeyOut;
+		free(emptyKey);
+		if(! (emptyKey = emptyKeyOut = malloc(strlen(options.emptyKey) * 2 + 2)))
+			exit(EX_OSERR);
+		if(! parseShellWord(&emptyKeyIn, &emptyKeyOut, 1))
+			*emptyKey = '\0';
+		//  The whole input is parsed at once, from the argument, the file, or stdin.  As in main(),
+		// the text of the argument or of a mapped file includes its NUL, while that read does not.
+		ssize_t length;
+		if(optind < argc)
+		{
+			inputText = argv[optind];
+			inputTextLength = strlen(inputText) + 1;
+			length = inputTextLength - 1;
+		}
+		else if(inputText)
+			length = inputTextLength - 1;
+		else
+		{
+			length = readAllInput();
+			input = (char *)inputText;
+		}
+		if(0 > length)
+		{
+			if(options.verbose)
+				fprintf(stderr, "Error reading input: %s\n", strerror(errno));
+			rc = options.stringify || options.encode ? EX_IOERR :
+				outputResult(JSON_C_VALUE(NULL), json_tokener_error_parse_eof);
+		}
+		else if(options.stringify)
+			rc = stringifyInput();
+		else if(options.encode)
+			rc = encodeShellVariables(inputText);
+		else
+		{
+			enum json_tokener_error parseError = json_tokener_success;
+			jsonValue obj = JSON_C_VALUE(NULL);
+		#ifdef USE_TAPE_PARSER
+			//  Values to be edited with --set or --merge are always json-c objects
+			if(! options.editCount && ! options.mergeCount)
+				obj = tapeParse(inputText, length);
+			if(! obj.entry)
+		#endif
+				obj = JSON_C_VALUE(parseInput(&parseError));
+			rc = outputResult(obj, parseError);
+			json_object_put(JSON_C_OBJECT(obj));
+		}
+		if(! rc && assignFailed)
+			rc = EXIT_FAILURE;
+	}
+	//  -j, -s, and --encode output to stdout
+	fflush(stdout);
+	for(int merge = 0; merge < mergeCount; merge++)
+		json_object_put(mergePatches[merge]);
+	free(input);
+	inputText = NULL;
+	if(inputMapping)
+	{
+		munmap(inputMapping, inputMappingLength);
+		inputMapping = NULL;
+	}
+	if(inputFd)
+	{
+		close(inputFd);
+		inputFd = 0;
+	}
+#ifdef USE_DECOMPRESSION
+	resetDecompression();
+#endif
+	free(argv);
+	return rc;
+}
+
+
+//  Called by enable -f, which fails if this returns 0
+int jkparse_builtin_load(char * name);
+int jkparse_builtin_load(char * name)
+{
+	defaultOptions = options;
+	return 1;
+}
+
+
+static char * jkparse_doc[] = {
+	"Parse JSON into shell variables.",
+	"",
+	"Parse JSON from the JSON argument, or from stdin if it is not given, and",
+	"assign JSON_TYPE, JSON_OBJ, and any other variables described by",
+	"jkparse --help, as evaluating the output of the jkparse command would.",
+	"Inside a function, the variables are local to it.",
+	"",
+	"Exit Status:",
+	"Returns the same exit code as the jkparse command.",
+	NULL
+};
+
+struct builtin jkparse_struct = {
+	"jkparse",
+	jkparse_builtin,
+	BUILTIN_ENABLED,
+	jkparse_doc,
+	"jkparse [OPTIONS...] [JSON]",
+	0
+};
+#else
+int main(int argc, char **argv)
+{
+	__fsetlocking(stdout, FSETLOCKING_BYCALLER);
+	output = stdout;
+#ifndef USE_EXTERNAL_PRINTF
+	//  Multibyte characters are escaped according to the locale, as an external printf would
+	setlocale(LC_CTYPE, "");
+#endif
+	//  The arguments from the first --group onward are the groups', and those preceding it are the
+	// defaults
+	int groupStart = nextGroup(argc, argv, 1);
+	{
+		int rc = parseOptions(groupStart, argv, OPTIONS_COMMAND_LINE);
+		if(-1 != rc)
+			return rc;
+		if(groupStart < argc && (options.printJson || options.multiple || options.stringify ||
+			options.encode || options.editCount || FORMAT_SHELL != options.format || serverFifo ||
+			cacheDir))
+		{
+			fputs("--group cannot be given with -j, -m, -s, --cache-dir, --encode, --format, "
+				"--server, or --set\n", stderr);
+			return EX_USAGE;
+		}
+		if(statsPath && (rc = startStats()))
+			return rc;
+		if((rc = loadMergePatches()))
+			return rc;
+	}
+	if(FORMAT_SHELL != options.format && (serverFifo || options.multiple))
+	{
+		fprintf(stderr, "--format cannot be given with %s\n", serverFifo ? "--server" : "-m");
+		return EX_USAGE;
+	}
+	if(serverFifo)
+	{
+		if(inputFile || cacheDir)
+		{
+			fprintf(stderr, "--%s cannot be given with --server\n", inputFile ? "file" : "cache-dir");
+			return EX_USAGE;
+		}
+		return serveRequests(argv[0]);
+	}
+	if(optind < groupStart)
+	{
+		if(inputFile)
+		{
+			fputs("A JSON argument cannot be given with --file\n", stderr);
+			return EX_USAGE;
+		}
+		//  The JSON object is an argument
+		inputText = argv[optind];
+		inputTextLength = strlen(inputText) + 1;
+		stats.bytesRead += inputTextLength - 1;
+	}
+	else if(inputFile)
+	{
+		int rc = mapInputFile(inputFile);
+		if(rc)
+			return rc;
+	}
+	if(cacheDir)
+	{
+		int rc = useCache();
+		if(-1 != rc)
+			return rc;
+	}
+	if(FORMAT_SHELL != options.format)
+		setvbuf(output, NULL, _IOFBF, RECORD_BUFFER_SIZE);
+	if(groupStart < argc)
+		return outputGroups(argc, argv, groupStart);
+	if(options.stringify)
+	{
+		STATS_SET_PHASE(STATS_OUTPUT);
+		return stringifyInput();
+	}
+	if(options.encode)
+	{
+		STATS_SET_PHASE(STATS_READ);
+		//  Input read from stdin goes through readAllInput() so that it is decompressed like any
+		// other
+		if(! inputText && 0 > readAllInput())
+		{
+			if(options.verbose)
+				fprintf(stderr, "Error reading input: %s\n", strerror(errno));
+			return EX_IOERR;
+		}
+		STATS_SET_PHASE(STATS_PARSE);
+		return encodeShellVariables(inputText);
+	}
+	STATS_SET_PHASE(STATS_PARSE);
+	if(options.multiple)
+		return multipleInput();
+	if(isStreamed())
+		return streamInput();
+	enum json_tokener_error parseError;
+	jsonValue val = parseDocument(&parseError);
+	return outputResult(val, parseError);
 }
+#endif
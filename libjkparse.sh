@@ -3,7 +3,7 @@
 # output from jkparse, presumably after modifications, back to JSON.  This is
 # intended to be sourced, although there are no license restrictions to prevent
 # copying the definitions within this file into another work.
-export LIBJKPARSE_VERSION=2
+export LIBJKPARSE_VERSION=3
 
 #  Copyright 2023-2024 Jason Hinsch
 #  No restrictions on use; Public Domain.
@@ -14,19 +14,8 @@ export LIBJKPARSE_VERSION=2
 # Consider piping their output through another tool for more human readable
 # output, such as jq or jsoncat.
 
-#  There are potential namespace conflicts in ksh with the jkparseToJson
-# functions.  Ideally, the jkparseToJson functions would have both their
-# own local variables and have access to their caller's variables.  In ksh,
-# however, it is not possible for a function to have both -- functions declared
-# with the function keyword cannot access variables declared by a calling
-# function that, itself, was also declared with the function keyword.  The
-# current implementation of the jkparseToJson functions will declare their
-# variables in the caller's namespace rather than function local, which 
-# permits them access to the named variables at the cost of potential name
-# conflicts.  ksh93u+m has plans to implement the local keyword which, if used
-# here, could resolve this issue.
-#  This is not a concern in bash which, using the same syntax, declare's its
-# variables function local while still having access to the callers variables.
+#  The jkparseToJson functions declare no variables of their own, so there are
+# no namespace conflicts with the names of the variables passed to them.
 
 #  The following functions are defined here:
 
@@ -95,14 +84,13 @@ export LIBJKPARSE_VERSION=2
 # array does not contain gaps, such as when jkparse generated the source array.
 # jkparseCompactArrayToJson() exists for these use cases.  This function will
 # skip missing indices in the resulting JSON if the source array is sparse.  It
-# is slightly faster than jkpaseArrayToJson(), although it does not guarantee
-# that the indices align with the source in all cases.
+# does not guarantee that the indices align with the source in all cases.
 
 # jkparseContinuousArrayToJson()
 #  $1 = name of JSON_OBJ
 #  $2 = name of JSON_OBJ_TYPES
-#  Possibly faster than jkparseCompactArrayToJson(), but does not handle
-# missing elements in bash and ksh gracefully.
+#  Retained for compatibility.  This is now the same as
+# jkparseCompactArrayToJson().
 
 # jkparseQToJson()
 #  $1 = $JSON_TYPE
@@ -119,41 +107,41 @@ export LIBJKPARSE_VERSION=2
 #  $1 = name of JSON_OBJ
 #  These are similar to functions of the same name without the Q, except that
 # they do not accept a JSON_OBJ_TYPES name argument.  These function versions
-# expect that the source variables were setup using jkparse's -q option.  These
-# are slightly faster than the versions that have additional type handling.
+# expect that the source variables were setup using jkparse's -q option.
 
 
 function jkparseGet
 {
-	[ ${#@} -gt 0 ] &&
-	. <(jkparse -q) && {
-		[ $JSON_TYPE = o ] || [ $JSON_TYPE = a ]
-	} && {
-		while [ ${#@} -gt 1 ];do
-			. <(jkparse -qu <<< "${JSON_OBJ[$1]}") && {
-				[ $JSON_TYPE = o ] || [ $JSON_TYPE = a ]
-			} || return
-			shift 1
-		done
-		[ "${JSON_OBJ[$1]}" ] && printf %s "${JSON_OBJ[$1]}"
-	}
+	[ ${#@} -gt 0 ] || return
+	#  Convert each argument into a path option for jkparse
+	typeset jkparseGetArgCount=${#@}
+	while [ $((jkparseGetArgCount--)) -gt 0 ];do
+		set -- "$@" -p "$1"
+		shift
+	done
+	if [ -n "$ZSH_VERSION" ] && ! [[ -o ksharrays ]];then
+		jkparse -jb1 "$@"
+	else
+		jkparse -j "$@"
+	fi
 }
 
 function jkparseSet
 {
-	. <(jkparse -q) && {
-		[ $JSON_TYPE = o ] || [ $JSON_TYPE = a ]
-	} &&
-	if [ ${#@} -lt 3 ];then
-		. <(jkparse -qo '' -t '' <<< "$2") &&
-		JSON_OBJ[$1]=$2
+	[ ${#@} -gt 1 ] || return
+	#  Convert each argument but the last into a path option for jkparse, and the
+	# last into the value to set
+	typeset jkparseSetArgCount=$((${#@} - 1))
+	while [ $((jkparseSetArgCount--)) -gt 0 ];do
+		set -- "$@" -p "$1"
+		shift
+	done
+	set -- "$@" --set "$1"
+	shift
+	if [ -n "$ZSH_VERSION" ] && ! [[ -o ksharrays ]];then
+		jkparse -jb1 "$@"
 	else
-		JSON_OBJ[$1]=$(jkparseSet "${@:2}" <<< "${JSON_OBJ[$1]}")
-	fi &&
-	if [ $JSON_TYPE = o ];then
-		jkparseQObjToJson JSON_OBJ
-	else
-		jkparseQContinuousArrayToJson JSON_OBJ
+		jkparse -j "$@"
 	fi
 }
 
@@ -177,218 +165,61 @@ jkparseQToJson ()
 	esac
 }
 
-#  To avoid any possible name conflicts with the name arguments, the names of
-# local variables inside these functions incorporate all variable argument
-# names.
-if [ -n "$ZSH_VERSION" ];then
-	jkparseObjToJson ()
-	{
-		#  key and comma flag local variables
-		echo -n '{'
-		eval "local k$1$2 c$2$1=
-		for k$1$2 in \"\${(@k)$1}\";do
-			[ -z \"\$c$2$1\" ] || echo -n ,
-			c$2$1=1
-			if [ \"\$k$1$2\" = \"\${3-$'\1'}\" ];then
-				printf '\"\"'
-			else
-				jkparse -qs -- \"\$k$1$2\"
-			fi
-			case \"\${$2[\$k$1$2]}\" in
-				s) echo -n :
-				   jkparse -qs -- \"\${$1[\$k$1$2]}\";;
-				n) echo -n :null;;
-				*) printf %s :\"\${$1[\$k$1$2]}\";;
-			esac
-		done"
-		echo -n '}'
-	}
-	
-	jkparseQObjToJson ()
-	{
-		#  key and comma flag local variables
-		echo -n '{'
-		eval "local k$1 c$1=
-		for k$1 in \"\${(@k)$1}\";do
-			[ -z \"\$c$1\" ] || echo -n ,
-			c$1=1
-			if [ \"\$k$1\" = \"\${2-$'\1'}\" ];then
-				printf '\"\"'
-			else
-				jkparse -qs -- \"\$k$1\"
-			fi
-			printf %s :\"\${$1[\$k$1]}\"
-		done"
-		echo -n '}'
-	}
-	
-	#  zsh does not create sparse arrays
-	jkparseArrayToJson ()
-	{
-		#  index local variable
-		echo -n [
-		eval "local i$1$2=0
-		while [ \$i$1$2 -lt \${#$1[@]} ];do
-			[ \"\$((i$1$2++))\" = 0 ] || echo -n ,
-			case \"\${$2[\$i$1$2]}\" in
-				s) jkparse -qs -- \"\${$1[\$i$1$2]}\";;
-				n) echo -n null;;
-				*) printf %s \"\${$1[\$i$1$2]}\";;
-			esac
-		done"
-		echo -n ]
-	}
-	
-	jkparseQArrayToJson ()
-	{
-		#  index local variable
-		echo -n [
-		eval "local i$1=0
-		while [ \$i$1 -lt \${#$1[@]} ];do
-			[ \"\$((i$1++))\" = 0 ] || echo -n ,
-			printf %s \"\${$1[\$i$1]}\"
-		done"
-		echo -n ]
-	}
-	
-	alias jkparseCompactArrayToJson=jkparseArrayToJson
-	alias jkparseQCompactArrayToJson=jkparseQArrayToJson
-	alias jkparseContinuousArrayToJson=jkparseArrayToJson
-	alias jkparseQContinuousArrayToJson=jkparseQArrayToJson
-else
-	jkparseObjToJson ()
-	{
-		#  key and comma flag local variables
-		echo -n '{'
-		eval "typeset k$1$2 c$2$1=
-		for k$1$2 in \"\${!$1[@]}\";do
-			[ -z \"\$c$2$1\" ] || echo -n ,
-			c$2$1=1
-			if [ \"\$k$1$2\" = \"\${3-$'\1'}\" ];then
-				printf '\"\"'
-			else
-				jkparse -qs -- \"\$k$1$2\"
-			fi
-			case \"\${$2[\$k$1$2]}\" in
-				s) echo -n :
-				   jkparse -qs -- \"\${$1[\$k$1$2]}\";;
-				n) echo -n :null;;
-				*) echo -n :\"\${$1[\$k$1$2]}\";;
-			esac
-		done"
-		echo -n '}'
-	}
-	
-	jkparseQObjToJson ()
-	{
-		#  key and comma flag local variables
-		echo -n '{'
-		eval "typeset k$1 c$1=
-		for k$1 in \"\${!$1[@]}\";do
-			[ -z \"\$c$1\" ] || echo -n ,
-			c$1=1
-			if [ \"\$k$1\" = \"\${2-$'\1'}\" ];then
-				printf '\"\"'
-			else
-				jkparse -qs -- \"\$k$1\"
-			fi
-			echo -n :\"\${$1[\$k$1]}\"
-		done"
-		echo -n '}'
-	}
-	
-	#  When the shell array is sparse, this version will generate null values
-	# for the missing indices in the resulting JSON.
-	jkparseArrayToJson ()
-	{
-		#  index and limit local variables.
-		echo -n [
-		eval "typeset i$1$2=-1 l$2$1
-		for l$2$1 in \"\${!$1[@]}\";do true; done
-		let l$2$1++
-		while [ \$((++i$1$2)) -lt \$l$2$1 ];do
-			[ \"\$i$1$2\" = 0 ] || echo -n ,
-			case \"\${$2[\$i$1$2]}\" in
-				s) jkparse -qs -- \"\${$1[\$i$1$2]}\";;
-				n) echo -n null;;
-				*) echo -n \"\${$1[\$i$1$2]-null}\";;
-			esac
-		done"
-		echo -n ]
-	}
-	
-	jkparseQArrayToJson ()
-	{
-		#  index and limit local variables.
-		echo -n [
-		eval "typeset i$1=-1 l$1
-		for l$1 in \"\${!$1[@]}\";do :; done
-		let l$1++
-		while [ \$((++i$1)) -lt \$l$1 ];do
-			[ \"\$i$1\" = 0 ] || echo -n ,
-			echo -n \"\${$1[\$i$1]-null}\"
-		done"
-		echo -n ]
-	}
-	
-	#  When the shell array is sparse, this version will skip missing indices
-	# in the resulting JSON.  A sparse array will not have the same indices in
-	# JSON as it did in the shell (zsh's count from 1 notwithstanding)
-	jkparseCompactArrayToJson ()
-	{
-		#  key and comma flag local variables
-		echo -n [
-		eval "typeset k$1$2 c$2$1=
-		for k$1$2 in \"\${!$1[@]}\";do
-			[ -z \"\$c$2$1\" ] || echo -n ,
-			c$2$1=1
-			case \"\${$2[\$k$1$2]}\" in
-				s) jkparse -qs -- \"\${$1[\$k$1$2]}\";;
-				n) echo -n null;;
-				*) echo -n \"\${$1[\$k$1$2]}\";;
-			esac
-		done"
-		echo -n ]
-	}
-	
-	jkparseQCompactArrayToJson ()
-	{
-		#  key and comma flag local variables
-		echo -n [
-		eval "typeset k$1 c$1=
-		for k$1 in \"\${!$1[@]}\";do
-			[ -z \"\$c$1\" ] || echo -n ,
-			c$1=1
-			echo -n \"\${$1[\$k$1]}\"
-		done"
-		echo -n ]
-	}
-	
-	jkparseContinuousArrayToJson()
-	{
-		#  index local variable
-		echo -n [
-		eval "typeset i$1$2=-1
-		while [ \$((++i$1$2)) -lt \${#$1[@]} ];do
-			[ \"\$i$1$2\" = 0 ] || echo -n ,
-			case \"\${$2[\$i$1$2]}\" in
-				s) jkparse -qs -- \"\${$1[\$i$1$2]}\";;
-				n) echo -n null;;
-				*) echo -n \"\${$1[\$i$1$2]}\";;
-			esac
-		done"
-		echo -n ]
-	}
-	
-	jkparseQContinuousArrayToJson()
-	{
-		#  index local variable
-		echo -n [
-		eval "typeset i$1=-1
-		while [ \$((++i$1)) -lt \${#$1[@]} ];do
-			[ \"\$i$1\" = 0 ] || echo -n ,
-			echo -n \"\${$1[\$i$1]}\"
-		done"
-		echo -n ]
-	}
-fi
+#  The variables are encoded by jkparse from the output of typeset -p, which
+# is understood for bash, ksh, and zsh alike.  EMPTY_KEY is passed to jkparse
+# as shell code, as it would be given to jkparse -e.
+jkparseObjToJson ()
+{
+	if [ ${#@} -gt 2 ];then
+		typeset -p "$1" "$2" 2>/dev/null |
+			jkparse --encode -o "$1" -a "$2" -e "$(printf %q "$3")"
+	else
+		typeset -p "$1" "$2" 2>/dev/null | jkparse --encode -o "$1" -a "$2"
+	fi
+}
+
+jkparseQObjToJson ()
+{
+	if [ ${#@} -gt 1 ];then
+		typeset -p "$1" 2>/dev/null |
+			jkparse --encode -o "$1" -e "$(printf %q "$2")"
+	else
+		typeset -p "$1" 2>/dev/null | jkparse --encode -o "$1"
+	fi
+}
+
+#  When the shell array is sparse, this version will generate null values
+# for the missing indices in the resulting JSON.
+jkparseArrayToJson ()
+{
+	typeset -p "$1" "$2" 2>/dev/null | jkparse --encode -o "$1" -a "$2"
+}
+
+jkparseQArrayToJson ()
+{
+	typeset -p "$1" 2>/dev/null | jkparse --encode -o "$1"
+}
+
+#  When the shell array is sparse, this version will skip missing indices
+# in the resulting JSON.  A sparse array will not have the same indices in
+# JSON as it did in the shell (zsh's count from 1 notwithstanding)
+jkparseCompactArrayToJson ()
+{
+	typeset -p "$1" "$2" 2>/dev/null |
+		jkparse --encode=compact -o "$1" -a "$2"
+}
+
+jkparseQCompactArrayToJson ()
+{
+	typeset -p "$1" 2>/dev/null | jkparse --encode=compact -o "$1"
+}
+
+jkparseContinuousArrayToJson ()
+{
+	jkparseCompactArrayToJson "$@"
+}
+
+jkparseQContinuousArrayToJson ()
+{
+	jkparseQCompactArrayToJson "$@"
+}